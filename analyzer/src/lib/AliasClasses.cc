@@ -0,0 +1,47 @@
+//===-- AliasClasses.cc - Alias classes of pointers-------------===//
+//
+// This file stores the alias sets found by PointerAnalysisPass as
+// classes of pointers with contiguous members.
+//
+//===-----------------------------------------------------------===//
+
+#include "AliasClasses.h"
+
+void AliasClasses::build(ArrayRef<Value *> Ptrs, UnionFind &UF) {
+
+	ClassIDs.clear();
+	ClassOffsets.clear();
+	ClassMembers.clear();
+
+	// Number the classes in the order of their first members
+	vector<uint32_t> RootClasses(Ptrs.size(), ~0U);
+	vector<uint32_t> PtrClasses(Ptrs.size(), ~0U);
+	vector<uint32_t> ClassSizes;
+	for (uint32_t i = 0; i < Ptrs.size(); ++i) {
+		if (UF.getSize(i) < 2)
+			continue;
+		uint32_t R = UF.find(i);
+		if (RootClasses[R] == ~0U) {
+			RootClasses[R] = ClassSizes.size();
+			ClassSizes.push_back(0);
+		}
+		PtrClasses[i] = RootClasses[R];
+		++ClassSizes[PtrClasses[i]];
+	}
+	if (ClassSizes.empty())
+		return;
+
+	ClassOffsets.assign(ClassSizes.size() + 1, 0);
+	for (size_t c = 0; c < ClassSizes.size(); ++c)
+		ClassOffsets[c + 1] = ClassOffsets[c] + ClassSizes[c];
+
+	ClassMembers.assign(ClassOffsets.back(), NULL);
+	ClassIDs.reserve(ClassMembers.size());
+	vector<uint32_t> Pos(ClassOffsets.begin(), ClassOffsets.end() - 1);
+	for (uint32_t i = 0; i < Ptrs.size(); ++i) {
+		if (PtrClasses[i] == ~0U)
+			continue;
+		ClassMembers[Pos[PtrClasses[i]]++] = Ptrs[i];
+		ClassIDs[Ptrs[i]] = PtrClasses[i];
+	}
+}
@@ -0,0 +1,108 @@
+#ifndef ALIAS_CLASSES_H
+#define ALIAS_CLASSES_H
+
+#include <llvm/IR/Value.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+// Union-find over dense IDs, with path halving and union by size
+class UnionFind {
+
+	public:
+		UnionFind(size_t N) : Parents(N), Sizes(N, 1) {
+			for (uint32_t i = 0; i < N; ++i)
+				Parents[i] = i;
+		}
+
+		uint32_t find(uint32_t i) {
+			while (Parents[i] != i) {
+				Parents[i] = Parents[Parents[i]];
+				i = Parents[i];
+			}
+			return i;
+		}
+
+		// Returns false if i and j are already in the same set
+		bool unite(uint32_t i, uint32_t j) {
+			i = find(i);
+			j = find(j);
+			if (i == j)
+				return false;
+			if (Sizes[i] < Sizes[j])
+				std::swap(i, j);
+			Parents[j] = i;
+			Sizes[i] += Sizes[j];
+			return true;
+		}
+
+		uint32_t getSize(uint32_t i) { return Sizes[find(i)]; }
+
+	private:
+		vector<uint32_t> Parents, Sizes;
+};
+
+// The pointers of an alias class. A pointer without aliases is a
+// class of its own.
+class AliasClass {
+
+	public:
+		AliasClass(Value *V) : Single(V) { }
+		AliasClass(ArrayRef<Value *> Members_)
+			: Single(NULL), Members(Members_) { }
+
+		Value *const *begin() const {
+			return Members.empty() ? &Single : Members.begin();
+		}
+		Value *const *end() const {
+			return Members.empty() ? &Single + 1 : Members.end();
+		}
+		size_t size() const {
+			return Members.empty() ? 1 : Members.size();
+		}
+
+	private:
+		Value *Single;
+		ArrayRef<Value *> Members;
+};
+
+//
+// Alias classes of the pointers of a function. Aliased pointers are
+// merged into equivalence classes, so aliasing is taken as
+// transitive. Each pointer with aliases is mapped to a class ID, and
+// the members of a class are stored contiguously.
+//
+class AliasClasses {
+
+	public:
+		// Build the classes from the sets of UF over Ptrs; pointers
+		// in singleton sets are not recorded
+		void build(ArrayRef<Value *> Ptrs, UnionFind &UF);
+
+		// The class of V, including V itself
+		AliasClass getClass(Value *V) const {
+			auto it = ClassIDs.find(V);
+			if (it == ClassIDs.end())
+				return AliasClass(V);
+			uint32_t C = it->second;
+			return AliasClass(makeArrayRef(ClassMembers.data() +
+						ClassOffsets[C], ClassOffsets[C + 1] - ClassOffsets[C]));
+		}
+
+		size_t getNumClasses() const {
+			return ClassOffsets.empty() ? 0 : ClassOffsets.size() - 1;
+		}
+		size_t getNumPointers() const { return ClassMembers.size(); }
+
+	private:
+		DenseMap<Value *, uint32_t> ClassIDs;
+		// Members of class i are ClassMembers[ClassOffsets[i],
+		// ClassOffsets[i + 1])
+		vector<uint32_t> ClassOffsets;
+		vector<Value *> ClassMembers;
+};
+
+#endif
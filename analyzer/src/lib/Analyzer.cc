@@ -31,7 +31,6 @@
 #include "Config.h"
 #include "SecurityChecks.h"
 #include "MissingChecks.h"
-#include "PointerAnalysis.h"
 #include "TypeInitializer.h"
 
 using namespace llvm;
@@ -44,6 +43,15 @@ cl::opt<unsigned> VerboseLevel(
     "verbose-level", cl::desc("Print information at which verbose level"),
     cl::init(0));
 
+cl::opt<unsigned> NumThreadsOpt(
+    "j", cl::desc("Number of threads for parallel analyses (0: one per core)"),
+    cl::init(1));
+
+cl::opt<string> SourceRoot(
+    "source-root",
+    cl::desc("Root of the source tree, for printing source code"),
+    cl::init(""));
+
 cl::opt<bool> SecurityChecks(
     "sc", 
     cl::desc("Identify sanity checks"), 
@@ -54,6 +62,29 @@ cl::opt<bool> MissingChecks(
 		cl::desc("Identify missing-check bugs"),
 		cl::NotHidden, cl::init(false));
 
+cl::opt<string> CallGraphFile(
+		"cg-file",
+		cl::desc("Load the call graph from the file, updating it for the "
+			"changed input files, otherwise build it and save it to the file"),
+		cl::NotHidden, cl::init(""));
+
+cl::opt<bool> VerifyCallGraph(
+		"cg-verify",
+		cl::desc("Compare the call graph loaded from -cg-file with a full "
+			"rebuild"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<bool> GlobalPointsTo(
+		"global-pta",
+		cl::desc("Find aliases with the inter-procedural unification-based "
+			"points-to analysis instead of per-function basic AA"),
+		cl::NotHidden, cl::init(false));
+
+cl::opt<bool> BenchMLTA(
+		"bench-mlta",
+		cl::desc("Benchmark MLTA set intersections on indirect calls"),
+		cl::NotHidden, cl::init(false));
+
 
 GlobalContext GlobalCtx;
 
@@ -114,6 +145,46 @@ void LoadStaticData(GlobalContext *GCtx) {
 	SetCopyFuncs(GCtx->CopyFuncs);
 	// load data-fetch functions
 	SetDataFetchFuncs(GCtx->DataFetchFuncs);
+	// load functions to be skipped
+	SetSkipFuncs(GCtx->SkipFuncs);
+}
+
+// Classify all functions by their configured roles, so that the
+// analyses do not need to match names at every call site
+void BuildFuncRoleTable(GlobalContext *GCtx) {
+
+	for (auto M : GCtx->Modules) {
+		for (Function &F : *M.first) {
+			string FName = F.getName().str();
+			FuncRoles FR;
+
+			if (F.getName().endswith("printk"))
+				FR.Mask |= FR_Printk;
+			if (GCtx->ErrorHandleFuncs.count(FName))
+				FR.Mask |= FR_ErrHandle;
+
+			auto dit = GCtx->DataFetchFuncs.find(FName);
+			if (dit != GCtx->DataFetchFuncs.end()) {
+				FR.Mask |= FR_DataFetch;
+				FR.FetchDst = dit->second.first;
+				FR.FetchSrc = dit->second.second;
+			}
+
+			auto cit = GCtx->CopyFuncs.find(FName);
+			if (cit != GCtx->CopyFuncs.end()) {
+				FR.Mask |= FR_Copy;
+				FR.CopySrc = get<0>(cit->second);
+				FR.CopyDst = get<1>(cit->second);
+				FR.CopySize = get<2>(cit->second);
+			}
+
+			if (GCtx->SkipFuncs.count(FName))
+				FR.Mask |= FR_Skip;
+
+			if (FR.Mask)
+				GCtx->FuncRoleTable[&F] = FR;
+		}
+	}
 }
 
 void ProcessResults(GlobalContext *GCtx) {
@@ -165,9 +236,27 @@ int main(int argc, char **argv) {
 	TIPass.run(GlobalCtx.Modules);
 	TIPass.BuildTypeStructMap();
 
-	// Build global callgraph.
+	// Build global callgraph. With a call-graph file, the facts of
+	// each module are kept, so that the saved graph can be updated
+	// when some of the modules change.
 	CallGraphPass CGPass(&GlobalCtx);
-	CGPass.run(GlobalCtx.Modules);
+	if (!CallGraphFile.empty())
+		CGPass.setIncremental(true);
+	if (CallGraphFile.empty() ||
+			!CGPass.loadCallGraph(CallGraphFile, GlobalCtx.Modules)) {
+		CGPass.run(GlobalCtx.Modules);
+		if (!CallGraphFile.empty())
+			CGPass.saveCallGraph(CallGraphFile, GlobalCtx.Modules);
+	}
+	else {
+		if (CGPass.wasUpdated())
+			CGPass.saveCallGraph(CallGraphFile, GlobalCtx.Modules);
+		if (VerifyCallGraph)
+			CGPass.verifyCallGraph(GlobalCtx.Modules);
+	}
+	BuildFuncRoleTable(&GlobalCtx);
+	if (BenchMLTA)
+		CGPass.benchmarkMLTA();
 
 	// Identify sanity checks
 	if (SecurityChecks) {
@@ -175,11 +264,13 @@ int main(int argc, char **argv) {
 		SCPass.run(GlobalCtx.Modules);
 	}
 
-	// Identify missing-check bugs
+	// Identify missing-check bugs. Pointer analysis is done on
+	// demand for the functions MissingChecksPass queries.
 	if (MissingChecks) {
-		// Pointer analysis
-		PointerAnalysisPass PAPass(&GlobalCtx);
-		PAPass.run(GlobalCtx.Modules);
+		if (GlobalPointsTo) {
+			GlobalCtx.PointsTo = make_unique<SteensgaardPTA>(&GlobalCtx);
+			GlobalCtx.PointsTo->solve();
+		}
 
 		SecurityChecksPass SCPass(&GlobalCtx);
 		SCPass.run(GlobalCtx.Modules);
@@ -190,7 +281,8 @@ int main(int argc, char **argv) {
 	}
 
 	// Print final results
-	//PrintResults(&GlobalCtx);
+	if (SecurityChecks)
+		PrintResults(&GlobalCtx);
 
 	return 0;
 }
@@ -19,8 +19,15 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <memory>
+#include <mutex>
 
 #include "Common.h"
+#include "CallGraphCSR.h"
+#include "CFGOverlay.h"
+#include "AliasClasses.h"
+#include "SteensgaardPTA.h"
+#include "MemoryDefUse.h"
 
 
 // 
@@ -34,17 +41,37 @@ typedef llvm::SmallPtrSet<llvm::Function*, 8> FuncSet;
 // Mapping from function name to function.
 typedef unordered_map<string, llvm::Function*> NameFuncMap;
 typedef llvm::SmallPtrSet<llvm::CallInst*, 8> CallInstSet;
-typedef DenseMap<Function*, CallInstSet> CallerMap;
-typedef DenseMap<CallInst *, FuncSet> CalleeMap;
 // Pointer analysis types.
-typedef DenseMap<Value *, SmallPtrSet<Value *, 16>> PointerAnalysisMap;
-typedef unordered_map<Function *, PointerAnalysisMap> FuncPointerAnalysisMap;
-typedef unordered_map<Function *, AAResults *> FuncAAResultsMap;
+typedef unordered_map<Function *, AliasClasses> FuncPointerAnalysisMap;
 typedef map<Type*, string> TypeNameMap;
 
+// Roles of a function, as configured in configs/
+enum FuncRole {
+	FR_ErrHandle = 1,
+	FR_DataFetch = 2,
+	FR_Copy = 4,
+	FR_Skip = 8,
+	// *printk: error handling depends on the log level of the
+	// format string
+	FR_Printk = 16,
+};
+
+struct FuncRoles {
+	FuncRoles() : Mask(0), FetchDst(-1), FetchSrc(-1),
+		CopySrc(-1), CopyDst(-1), CopySize(-1) { }
+
+	// Bitmask of FuncRole
+	uint8_t Mask;
+	// <dst_arg#, source_arg#> of a data-fetch function
+	int8_t FetchDst, FetchSrc;
+	// <src_arg#, dst_arg#, size_arg#> of a copy function
+	int8_t CopySrc, CopyDst, CopySize;
+};
+typedef DenseMap<Function *, FuncRoles> FuncRoleMap;
+
 struct GlobalContext {
 
-	GlobalContext() {
+	GlobalContext() : CallGraph(this) {
 		// Initialize statistucs.
 		NumSecurityChecks = 0;
 		NumCondStatements = 0;
@@ -62,11 +89,9 @@ struct GlobalContext {
 	// Functions whose addresses are taken.
 	FuncSet AddressTakenFuncs;
 
-	// Map a callsite to all potential callee functions.
-	CalleeMap Callees;
-
-	// Map a function to all potential caller instructions.
-	CallerMap Callers;
+	// The call graph: potential callees of call sites and potential
+	// caller instructions of functions.
+	CallGraphCSR CallGraph;
 
 	// Indirect call instructions.
 	std::vector<CallInst *>IndirectCallInsts;
@@ -79,6 +104,25 @@ struct GlobalContext {
 	// Map function signature to functions
 	DenseMap<size_t, FuncSet>sigFuncsMap;
 
+	// Dense IDs of functions
+	vector<Function *>IDFuncs;
+	DenseMap<Function *, uint32_t>FuncIDs;
+
+	uint32_t getFuncID(Function *F) {
+		auto it = FuncIDs.find(F);
+		if (it != FuncIDs.end())
+			return it->second;
+		uint32_t ID = IDFuncs.size();
+		IDFuncs.push_back(F);
+		FuncIDs[F] = ID;
+		return ID;
+	}
+
+	// CFG overlays of functions, built on demand
+	DenseMap<Function *, unique_ptr<CFGOverlay>> CFGOverlays;
+	mutex CFGOverlayMutex;
+	const CFGOverlay &getCFGOverlay(Function *F);
+
 	// Modules.
 	ModuleList Modules;
 	ModuleNameMap ModuleMaps;
@@ -94,11 +138,67 @@ struct GlobalContext {
 	DenseMap<Function *, set<Value *>> CheckInstSets;
 
 
-	// Pointer analysis results.
+	// Pointer analysis results, computed on the first query of each
+	// function with the analysis context of its module, or published
+	// by parallel workers
     FuncPointerAnalysisMap FuncPAResults;
-    FuncAAResultsMap FuncAAResults;
+	mutex AliasClassesMutex;
+	const AliasClasses &getAliasClasses(Function *F);
+	// Keep the classes of F unless it already has some
+	const AliasClasses &publishAliasClasses(Function *F,
+			AliasClasses &&Classes);
+	bool hasAliasClasses(Function *F) {
+		lock_guard<mutex> Lock(AliasClassesMutex);
+		return FuncPAResults.count(F);
+	}
+	// With -global-pta, aliases are taken from the solved
+	// inter-procedural points-to analysis instead of basic AA
+	unique_ptr<SteensgaardPTA> PointsTo;
+
+	// Def-use of memory of functions, built on demand
+	DenseMap<Function *, unique_ptr<MemoryDefUse>> MemoryDefUses;
+	mutex MemoryDefUseMutex;
+	MemoryDefUse &getMemoryDefUse(Function *F);
+
+	// Analysis contexts of the modules of the analyzed functions
+	DenseMap<Module *, unique_ptr<ModuleOracle>> ModuleOracles;
+	mutex ModuleOracleMutex;
+	ModuleOracle &getModuleOracle(Module *M);
+
+	// Assumption caches register value handles in the LLVMContext,
+	// which the functions of a module share, so parallel workers scan
+	// and destroy them under this lock
+	mutex AssumptionMutex;
+
+	// Evict the per-function analyses, and free the module contexts
+	// they use
+	void releaseFuncAnalyses() {
+		lock_guard<mutex> PALock(AliasClassesMutex);
+		lock_guard<mutex> MDULock(MemoryDefUseMutex);
+		lock_guard<mutex> MOLock(ModuleOracleMutex);
+		FuncPAResults.clear();
+		MemoryDefUses.clear();
+		ModuleOracles.clear();
+	}
 
 	map<string, pair<int8_t, int8_t>> DataFetchFuncs;
+	set<string> SkipFuncs;
+
+	// Roles of all functions, classified once after building the
+	// call graph
+	FuncRoleMap FuncRoleTable;
+
+	// Get the roles of the function called by CI; NULL if it has none
+	FuncRoles *getCalleeRoles(CallInst *CI) {
+		Function *CF = dyn_cast<Function>(
+				CI->getCalledValue()->stripPointerCasts());
+		if (!CF)
+			return NULL;
+		auto it = FuncRoleTable.find(CF);
+		if (it == FuncRoleTable.end())
+			return NULL;
+		return &it->second;
+	}
 };
 
 class IterativeModulePass {
@@ -0,0 +1,121 @@
+//===-- CFGOverlay.cc - CFG view of the analyses----------------===//
+//
+// This file builds the successor and predecessor arrays of the CFG
+// overlay of a function, unrolling loops once under UNROLL_LOOP_ONCE,
+// and numbers its edges.
+// Overlays are built on demand and kept in the global context.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/Analysis/LoopInfo.h>
+
+#include "CFGOverlay.h"
+#include "Analyzer.h"
+#include "Config.h"
+
+CFGOverlay::CFGOverlay(Function *F) {
+
+	for (BasicBlock &BB : *F) {
+		BlockIDs[&BB] = Blocks.size();
+		Blocks.push_back(&BB);
+	}
+
+	vector<SmallVector<BasicBlock *, 2>> Succs(Blocks.size());
+	for (size_t i = 0; i < Blocks.size(); ++i) {
+		for (BasicBlock *Succ : llvm::successors(Blocks[i]))
+			Succs[i].push_back(Succ);
+	}
+
+#ifdef UNROLL_LOOP_ONCE
+	removeBackEdges(F, Succs);
+#endif
+
+	// Successor rows, and predecessor rows by counting, so that
+	// predecessors are in block order
+	vector<uint32_t> NumPreds(Blocks.size(), 0);
+	SuccOffsets.assign(1, 0);
+	for (size_t i = 0; i < Blocks.size(); ++i) {
+		for (BasicBlock *Succ : Succs[i]) {
+			uint32_t j = BlockIDs[Succ];
+			uint32_t E = EdgeSrcs.size();
+			for (uint32_t k = SuccOffsets[i]; k < SuccCol.size(); ++k) {
+				if (SuccCol[k] == Succ) {
+					E = SuccEdgeCol[k];
+					break;
+				}
+			}
+			if (E == EdgeSrcs.size()) {
+				EdgeSrcs.push_back(i);
+				EdgeDsts.push_back(j);
+			}
+			SuccCol.push_back(Succ);
+			SuccEdgeCol.push_back(E);
+			++NumPreds[j];
+		}
+		SuccOffsets.push_back(SuccCol.size());
+	}
+
+	PredOffsets.assign(Blocks.size() + 1, 0);
+	for (size_t i = 0; i < Blocks.size(); ++i)
+		PredOffsets[i + 1] = PredOffsets[i] + NumPreds[i];
+	PredCol.assign(SuccCol.size(), NULL);
+	PredEdgeCol.assign(SuccCol.size(), 0);
+	vector<uint32_t> Pos(PredOffsets.begin(), PredOffsets.end() - 1);
+	for (size_t i = 0; i < Blocks.size(); ++i) {
+		for (uint32_t k = SuccOffsets[i]; k < SuccOffsets[i + 1]; ++k) {
+			uint32_t P = Pos[BlockIDs[SuccCol[k]]]++;
+			PredCol[P] = Blocks[i];
+			PredEdgeCol[P] = SuccEdgeCol[k];
+		}
+	}
+}
+
+// Remove the edges from the latches of loops to their headers. Two
+// cases:
+// 1. The latch has only one successor (for or while loops): the
+//    latch goes to the successor of the header that is out of the
+//    loop, i.e., whose edge does not dominate the latch;
+// 2. The latch has two successors (do-while loops): the latch only
+//    goes to the other successor.
+void CFGOverlay::removeBackEdges(Function *F,
+		vector<SmallVector<BasicBlock *, 2>> &Succs) {
+
+	if (F->isDeclaration())
+		return;
+
+	DominatorTree DT(*F);
+	LoopInfo LI(DT);
+
+	for (Loop *LP : LI.getLoopsInPreorder()) {
+		BasicBlock *HeaderB = LP->getHeader();
+		SmallVector<BasicBlock *, 4> LatchBS;
+		LP->getLoopLatches(LatchBS);
+
+		for (BasicBlock *LatchB : LatchBS) {
+			auto &LS = Succs[BlockIDs[LatchB]];
+			LS.erase(std::remove(LS.begin(), LS.end(), HeaderB), LS.end());
+
+			// Case 1
+			if (LatchB->getSingleSuccessor() == HeaderB) {
+				BasicBlock *ExitB = NULL;
+				for (BasicBlock *SuccB : llvm::successors(HeaderB)) {
+					if (!DT.dominates(BasicBlockEdge(HeaderB, SuccB), LatchB))
+						ExitB = SuccB;
+				}
+				if (ExitB)
+					LS.push_back(ExitB);
+			}
+		}
+	}
+}
+
+const CFGOverlay &GlobalContext::getCFGOverlay(Function *F) {
+
+	lock_guard<mutex> Lock(CFGOverlayMutex);
+	unique_ptr<CFGOverlay> &CFG = CFGOverlays[F];
+	if (!CFG)
+		CFG = make_unique<CFGOverlay>(F);
+	return *CFG;
+}
@@ -0,0 +1,79 @@
+#ifndef CFG_OVERLAY_H
+#define CFG_OVERLAY_H
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/SmallVector.h>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+//
+// The CFG of a function as seen by the analyses, stored as successor
+// and predecessor arrays. With UNROLL_LOOP_ONCE, loops are unrolled
+// once: back edges are removed, and a latch whose only successor is
+// the loop header goes to the exit of the header instead, so the
+// overlay is acyclic. The IR itself is not changed.
+//
+class CFGOverlay {
+
+	public:
+		CFGOverlay(Function *F);
+
+		ArrayRef<BasicBlock *> successors(BasicBlock *BB) const {
+			uint32_t i = getBlockID(BB);
+			return makeArrayRef(SuccCol.data() + SuccOffsets[i],
+					SuccOffsets[i + 1] - SuccOffsets[i]);
+		}
+		ArrayRef<BasicBlock *> predecessors(BasicBlock *BB) const {
+			uint32_t i = getBlockID(BB);
+			return makeArrayRef(PredCol.data() + PredOffsets[i],
+					PredOffsets[i + 1] - PredOffsets[i]);
+		}
+
+		// IDs of the edges to the successors and from the predecessors
+		// of BB, in the order of successors() and predecessors()
+		ArrayRef<uint32_t> succEdgeIDs(BasicBlock *BB) const {
+			uint32_t i = getBlockID(BB);
+			return makeArrayRef(SuccEdgeCol.data() + SuccOffsets[i],
+					SuccOffsets[i + 1] - SuccOffsets[i]);
+		}
+		ArrayRef<uint32_t> predEdgeIDs(BasicBlock *BB) const {
+			uint32_t i = getBlockID(BB);
+			return makeArrayRef(PredEdgeCol.data() + PredOffsets[i],
+					PredOffsets[i + 1] - PredOffsets[i]);
+		}
+
+		// Blocks are numbered in function order
+		uint32_t getBlockID(BasicBlock *BB) const {
+			return BlockIDs.find(BB)->second;
+		}
+		size_t getNumBlocks() const { return Blocks.size(); }
+		BasicBlock *getBlock(uint32_t ID) const { return Blocks[ID]; }
+
+		// Edges are numbered in successor order; a successor repeated
+		// in a row, e.g., by cases of a switch, is a single edge
+		size_t getNumEdges() const { return EdgeSrcs.size(); }
+		uint32_t getEdgeSrc(uint32_t E) const { return EdgeSrcs[E]; }
+		uint32_t getEdgeDst(uint32_t E) const { return EdgeDsts[E]; }
+
+	private:
+		vector<BasicBlock *> Blocks;
+		DenseMap<BasicBlock *, uint32_t> BlockIDs;
+
+		// Successors of block i are SuccCol[SuccOffsets[i],
+		// SuccOffsets[i + 1]); the same for predecessors
+		vector<uint32_t> SuccOffsets, PredOffsets;
+		vector<BasicBlock *> SuccCol, PredCol;
+		vector<uint32_t> SuccEdgeCol, PredEdgeCol;
+		// Source and destination blocks of the edges
+		vector<uint32_t> EdgeSrcs, EdgeDsts;
+
+		void removeBackEdges(Function *F,
+				vector<SmallVector<BasicBlock *, 2>> &Succs);
+};
+
+#endif
@@ -6,8 +6,6 @@
 // First layer: matching function type
 // Second layer: matching struct type
 //
-// In addition, loops are unrolled as "if" statements
-//
 //===-----------------------------------------------------------===//
 
 #include <llvm/IR/DebugInfo.h>
@@ -19,6 +17,7 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/Hashing.h>
 #include <llvm/Analysis/CallGraph.h>
 #include "llvm/IR/Function.h"
 #include "llvm/Support/raw_ostream.h"  
@@ -39,193 +38,186 @@
 
 using namespace llvm;
 
-DenseMap<size_t, FuncSet> CallGraphPass::typeFuncsMap;
-unordered_map<size_t, set<size_t>> CallGraphPass::typeConfineMap;
-unordered_map<size_t, set<size_t>> CallGraphPass::typeTransitMap;
-set<size_t> CallGraphPass::typeEscapeSet;
-const DataLayout *CurrentLayout;
-// Find targets of indirect calls based on type analysis: as long as
-// the number and type of parameters of a function matches with the
-// ones of the callsite, we say the function is a possible target of
-// this call.
-void CallGraphPass::findCalleesWithType(CallInst *CI, FuncSet &S) {
+DenseMap<size_t, FuncIDSet> CallGraphPass::sigFuncIDsMap;
+DenseMap<size_t, FuncIDSet> CallGraphPass::typeFuncIDsMap;
+bool CallGraphPass::FuncIDSetsBuilt = false;
+DenseMap<size_t, FuncSet> CallGraphPass::MLTACalleesMap;
+// Per thread, as struct layouts are computed lazily by DataLayout
+thread_local const DataLayout *CurrentLayout;
+DenseMap<size_t, vector<Function *>> CallGraphPass::sigBucketMap;
+vector<Function *> CallGraphPass::varArgFuncs;
+DenseMap<FunctionType *, FuncSet> CallGraphPass::typeCalleesMap;
+mutex CallGraphPass::CacheMutex;
+
+// Normalize a parameter type into a coarse class. Two types can
+// only be matched by isTypeMatched() if they fall into the same
+// class. Pointers and pointer-width integers are put into one class
+// as "void *" and "char *" are treated as universal pointers.
+size_t CallGraphPass::paramTypeClass(Type *Ty) {
+
+	const size_t PtrClass = 1, StructClass = 2, IntClass = 3, OtherClass = 4;
+
+	if (Ty->isPointerTy())
+		return PtrClass;
+	if (Ty->isIntegerTy()) {
+		unsigned Width = Ty->getIntegerBitWidth();
+		if (Width == DL->getPointerSizeInBits())
+			return PtrClass;
+		return hash_combine(IntClass, Width);
+	}
+	if (Ty->isStructTy())
+		return StructClass;
+	return hash_combine(OtherClass, Ty->getTypeID());
+}
 
-	if (CI->isInlineAsm())
-		return;
+// Bucket address-taken functions by the number and the classes of
+// their parameters, so that an indirect call only needs to be matched
+// against the functions in its own bucket
+void CallGraphPass::buildSigBuckets() {
 
-	//
-	// TODO: performance improvement: cache results for types
-	//
-	CallSite CS(CI);
 	for (Function *F : Ctx->AddressTakenFuncs) {
 
-		// VarArg
-		if (F->getFunctionType()->isVarArg()) {
-			// Compare only known args in VarArg.
-		}
-		// otherwise, the numbers of args should be equal.
-		else if (F->arg_size() != CS.arg_size()) {
+		if (F->isIntrinsic())
 			continue;
-		}
 
-		if (F->isIntrinsic()) {
+		// VarArg: compare only known args
+		if (F->getFunctionType()->isVarArg()) {
+			varArgFuncs.push_back(F);
 			continue;
 		}
 
-		// Type matching on args.
-		bool Matched = true;
-		CallSite::arg_iterator AI = CS.arg_begin();
-		for (Function::arg_iterator FI = F->arg_begin(), 
-				FE = F->arg_end();
-				FI != FE; ++FI, ++AI) {
-			// Check type mis-matches.
-			// Get defined type on callee side.
-			Type *DefinedTy = FI->getType();
-			// Get actual type on caller side.
-			Type *ActualTy = (*AI)->getType();
-
-			if (DefinedTy == ActualTy)
-				continue;
-
-			// FIXME: this is a tricky solution for disjoint
-			// types in different modules. A more reliable
-			// solution is required to evaluate the equality
-			// of two types from two different modules.
-			// Since each module has its own type table, same
-			// types are duplicated in different modules. This
-			// makes the equality evaluation of two types from
-			// two modules very hard, which is actually done
-			// at link time by the linker.
-			while (DefinedTy->isPointerTy() && ActualTy->isPointerTy()) {
-				DefinedTy = DefinedTy->getPointerElementType();
-				ActualTy = ActualTy->getPointerElementType();
-			}
-			if (DefinedTy->isStructTy() && ActualTy->isStructTy() &&
-					(DefinedTy->getStructName().equals(ActualTy->getStructName())))
-				continue;
-			if (DefinedTy->isIntegerTy() && ActualTy->isIntegerTy() &&
-					DefinedTy->getIntegerBitWidth() == ActualTy->getIntegerBitWidth())
-				continue;
-			// TODO: more types to be supported.
-
-			// Make the type analysis conservative: assume universal
-			// pointers, i.e., "void *" and "char *", are equivalent to 
-			// any pointer type and integer type.
-			if (
-					(DefinedTy == Int8PtrTy &&
-					 (ActualTy->isPointerTy() || ActualTy == IntPtrTy)) 
-					||
-					(ActualTy == Int8PtrTy &&
-					 (DefinedTy->isPointerTy() || DefinedTy == IntPtrTy))
-			   )
-				continue;
-			else {
-				Matched = false;
-				break;
-			}
-		}
-
-		if (Matched)
-			S.insert(F);
+		SmallVector<size_t, 8> Classes;
+		for (Argument &A : F->args())
+			Classes.push_back(paramTypeClass(A.getType()));
+		size_t BH = hash_combine(F->arg_size(),
+				hash_combine_range(Classes.begin(), Classes.end()));
+		sigBucketMap[BH].push_back(F);
 	}
 }
 
+// Type matching on args: as long as the number and type of
+// parameters of a function matches with the ones of the callsite, we
+// say the function is a possible target of this call.
+bool CallGraphPass::isTypeMatched(CallInst *CI, Function *F) {
 
-void CallGraphPass::unrollLoops(Function *F) {
+	CallSite CS(CI);
 
-	if (F->isDeclaration())
-		return;
+	// VarArg
+	if (F->getFunctionType()->isVarArg()) {
+		// Compare only known args in VarArg.
+		if (F->arg_size() > CS.arg_size())
+			return false;
+	}
+	// otherwise, the numbers of args should be equal.
+	else if (F->arg_size() != CS.arg_size()) {
+		return false;
+	}
 
-	DominatorTree DT = DominatorTree();
-	DT.recalculate(*F);
-	LoopInfo *LI = new LoopInfo();
-	LI->releaseMemory();
-	LI->analyze(DT);
-
-	// Collect all loops in the function
-	set<Loop *> LPSet;
-	for (LoopInfo::iterator i = LI->begin(), e = LI->end(); i!=e; ++i) {
-
-		Loop *LP = *i;
-		LPSet.insert(LP);
-
-		list<Loop *> LPL;
-
-		LPL.push_back(LP);
-		while (!LPL.empty()) {
-			LP = LPL.front();
-			LPL.pop_front();
-			vector<Loop *> SubLPs = LP->getSubLoops();
-			for (auto SubLP : SubLPs) {
-				LPSet.insert(SubLP);
-				LPL.push_back(SubLP);
-			}
+	CallSite::arg_iterator AI = CS.arg_begin();
+	for (Function::arg_iterator FI = F->arg_begin(), 
+			FE = F->arg_end();
+			FI != FE; ++FI, ++AI) {
+		// Check type mis-matches.
+		// Get defined type on callee side.
+		Type *DefinedTy = FI->getType();
+		// Get actual type on caller side.
+		Type *ActualTy = (*AI)->getType();
+
+		if (DefinedTy == ActualTy)
+			continue;
+
+		// FIXME: this is a tricky solution for disjoint
+		// types in different modules. A more reliable
+		// solution is required to evaluate the equality
+		// of two types from two different modules.
+		// Since each module has its own type table, same
+		// types are duplicated in different modules. This
+		// makes the equality evaluation of two types from
+		// two modules very hard, which is actually done
+		// at link time by the linker.
+		while (DefinedTy->isPointerTy() && ActualTy->isPointerTy()) {
+			DefinedTy = DefinedTy->getPointerElementType();
+			ActualTy = ActualTy->getPointerElementType();
 		}
+		if (DefinedTy->isStructTy() && ActualTy->isStructTy() &&
+				(DefinedTy->getStructName().equals(ActualTy->getStructName())))
+			continue;
+		if (DefinedTy->isIntegerTy() && ActualTy->isIntegerTy() &&
+				DefinedTy->getIntegerBitWidth() == ActualTy->getIntegerBitWidth())
+			continue;
+		// TODO: more types to be supported.
+
+		// Make the type analysis conservative: assume universal
+		// pointers, i.e., "void *" and "char *", are equivalent to 
+		// any pointer type and integer type.
+		if (
+				(DefinedTy == Int8PtrTy &&
+				 (ActualTy->isPointerTy() || ActualTy == IntPtrTy)) 
+				||
+				(ActualTy == Int8PtrTy &&
+				 (DefinedTy->isPointerTy() || DefinedTy == IntPtrTy))
+		   )
+			continue;
+		else
+			return false;
 	}
 
-	for (Loop *LP : LPSet) {
+	return true;
+}
 
-		// Get the header,latch block, exiting block of every loop
-		BasicBlock *HeaderB = LP->getHeader();
+// Find targets of indirect calls based on type analysis. Only the
+// bucket of the call-site signature is matched, and results are
+// cached per function type of the call, which is unique within its
+// LLVMContext.
+void CallGraphPass::findCalleesWithType(CallInst *CI, FuncSet &S) {
 
-		unsigned NumBE = LP->getNumBackEdges();
-		SmallVector<BasicBlock *, 4> LatchBS;
+	if (CI->isInlineAsm())
+		return;
 
-		LP->getLoopLatches(LatchBS);
+	if (sigBucketMap.empty() && varArgFuncs.empty())
+		buildSigBuckets();
+
+	// The actual arguments of a call to a non-variadic type have the
+	// types of its parameters, so the callees only depend on the
+	// type. Those of variadic calls also depend on the extra
+	// arguments, so they are not cached.
+	FunctionType *FTy = CI->getFunctionType();
+	bool Cached = !FTy->isVarArg();
+	if (Cached) {
+		lock_guard<mutex> Lock(CacheMutex);
+		auto it = typeCalleesMap.find(FTy);
+		if (it != typeCalleesMap.end()) {
+			S = it->second;
+			return;
+		}
+	}
 
-		for (BasicBlock *LatchB : LatchBS) {
-			if (!HeaderB || !LatchB) {
-				OP<<"ERROR: Cannot find Header Block or Latch Block\n";
-				continue;
-			}
-			// Two cases:
-			// 1. Latch Block has only one successor:
-			// 	for loop or while loop;
-			// 	In this case: set the Successor of Latch Block to the 
-			//	successor block (out of loop one) of Header block
-			// 2. Latch Block has two successor: 
-			// do-while loop:
-			// In this case: set the Successor of Latch Block to the
-			//  another successor block of Latch block 
-
-			// get the last instruction in the Latch block
-			Instruction *TI = LatchB->getTerminator();
-			// Case 1:
-			if (LatchB->getSingleSuccessor() != NULL) {
-				for (succ_iterator sit = succ_begin(HeaderB); 
-						sit != succ_end(HeaderB); ++sit) {  
-
-					BasicBlock *SuccB = *sit;	
-					BasicBlockEdge BBE = BasicBlockEdge(HeaderB, SuccB);
-					// Header block has two successor,
-					// one edge dominate Latch block;
-					// another does not.
-					if (DT.dominates(BBE, LatchB))
-						continue;
-					else {
-						TI->setSuccessor(0, SuccB);
-					}
-				}
-			}
-			// Case 2:
-			else {
-				for (succ_iterator sit = succ_begin(LatchB); 
-						sit != succ_end(LatchB); ++sit) {
-
-					BasicBlock *SuccB = *sit;
-					// There will be two successor blocks, one is header
-					// we need successor to be another
-					if (SuccB == HeaderB)
-						continue;
-					else{
-						TI->setSuccessor(0, SuccB);
-					}
-				}	
-			}
+	CallSite CS(CI);
+	SmallVector<size_t, 8> Classes;
+	for (auto AI = CS.arg_begin(), AE = CS.arg_end(); AI != AE; ++AI)
+		Classes.push_back(paramTypeClass((*AI)->getType()));
+	size_t BH = hash_combine((size_t)CS.arg_size(),
+			hash_combine_range(Classes.begin(), Classes.end()));
+
+	auto bit = sigBucketMap.find(BH);
+	if (bit != sigBucketMap.end()) {
+		for (Function *F : bit->second) {
+			if (isTypeMatched(CI, F))
+				S.insert(F);
 		}
 	}
+	for (Function *F : varArgFuncs) {
+		if (isTypeMatched(CI, F))
+			S.insert(F);
+	}
+
+	if (Cached) {
+		lock_guard<mutex> Lock(CacheMutex);
+		typeCalleesMap[FTy] = S;
+	}
 }
 
+
 bool CallGraphPass::isCompositeType(Type *Ty) {
 	if (Ty->isStructTy() 
 			|| Ty->isArrayTy() 
@@ -254,7 +246,7 @@ bool CallGraphPass::typeConfineInInitializer(User *Ini) {
 				Type *ITy = U->getType();
 				// TODO: use offset?
 				unsigned ONo = oi->getOperandNo();
-				typeFuncsMap[typeIdxHash(ITy, ONo)].insert(F);
+				addTypeFunc(ITy, ONo, F);
 			}
 			// Case 2: a composite-type object (value) is assigned to a
 			// field of another composite-type object
@@ -302,7 +294,7 @@ bool CallGraphPass::typeConfineInStore(StoreInst *SI) {
 		Type *STy;
 		int Idx;
 		if (nextLayerBaseType(PO, STy, Idx, DL)) {
-			typeFuncsMap[typeIdxHash(STy, Idx)].insert(F);
+			addTypeFunc(STy, Idx, F);
 			return true;
 		}
 		else {
@@ -401,6 +393,55 @@ void CallGraphPass::transitType(Type *ToTy, Type *FromTy,
 		typeTransitMap[typeHash(ToTy)].insert(typeHash(FromTy));
 }
 
+void CallGraphPass::addTypeFunc(Type *Ty, int Idx, Function *F) {
+	size_t TH = typeHash(Ty);
+	typeFuncsMap[hashIdxHash(TH, Idx)].insert(F);
+	typeFieldsMap[TH].insert(Idx);
+}
+
+// Close the cast-transit relation of types once all modules are
+// initialized. The function sets of the fields of all transitted
+// types are merged into the ones of the type they are cast to, so
+// that MLTA needs a single lookup per layer.
+void CallGraphPass::closeTypeTransits() {
+
+	DenseMap<size_t, FuncSet> MergedFuncsMap;
+	for (auto &TT : typeTransitMap) {
+		size_t TH = TT.first;
+
+		// Collect all types transitively cast to this type
+		set<size_t> PT;
+		list<size_t> LT;
+		LT.push_back(TH);
+		while (!LT.empty()) {
+			size_t CT = LT.front();
+			LT.pop_front();
+
+			auto it = typeTransitMap.find(CT);
+			if (it == typeTransitMap.end())
+				continue;
+			for (size_t H : it->second) {
+				if (H == TH || !PT.insert(H).second)
+					continue;
+				LT.push_back(H);
+			}
+		}
+
+		for (size_t H : PT) {
+			auto fit = typeFieldsMap.find(H);
+			if (fit == typeFieldsMap.end())
+				continue;
+			for (int Idx : fit->second) {
+				FuncSet &FS = typeFuncsMap[hashIdxHash(H, Idx)];
+				MergedFuncsMap[hashIdxHash(TH, Idx)].insert(FS.begin(), FS.end());
+			}
+		}
+	}
+
+	for (auto &MF : MergedFuncsMap)
+		typeFuncsMap[MF.first].insert(MF.second.begin(), MF.second.end());
+}
+
 void CallGraphPass::funcSetIntersection(FuncSet &FS1, FuncSet &FS2, 
 		FuncSet &FS) {
 	FS.clear();
@@ -447,16 +488,42 @@ Value *CallGraphPass:: nextLayerBaseType(Value *V, Type * &BTy,
 		return NULL;
 }
 
-bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
+// Number the functions of the first-layer and the second-layer type
+// maps with dense IDs, and store the sets as sorted ID arrays
+void CallGraphPass::buildFuncIDSets() {
 
-	// Initial set: first-layer results
-	FuncSet FS1 = Ctx->sigFuncsMap[callHash(CI)];
-	if (FS1.size() == 0) {
-		// No need to go through MLTA if the first layer is empty
-		return false;
+	closeTypeTransits();
+
+	vector<uint32_t> IDs;
+	for (auto &SF : Ctx->sigFuncsMap) {
+		IDs.clear();
+		for (Function *F : SF.second)
+			IDs.push_back(Ctx->getFuncID(F));
+		sigFuncIDsMap[SF.first].assign(IDs);
 	}
+	for (auto &TF : typeFuncsMap) {
+		IDs.clear();
+		for (Function *F : TF.second)
+			IDs.push_back(Ctx->getFuncID(F));
+		typeFuncIDsMap[TF.first].assign(IDs);
+	}
+	FuncIDSetsBuilt = true;
+}
+
+const FuncIDSet &CallGraphPass::getTypeFuncIDs(size_t TIH) {
+
+	static const FuncIDSet EmptySet;
+	auto it = typeFuncIDsMap.find(TIH);
+	if (it == typeFuncIDsMap.end())
+		return EmptySet;
+	return it->second;
+}
 
-	FuncSet FS2, FST;
+// Collect the <type hash, field index> of all layers of the called
+// value below the first one. Returns the hash of the call signature
+// CH and the layer chain.
+size_t CallGraphPass::collectLayers(CallInst *CI, size_t CH,
+		SmallVectorImpl<pair<size_t, int>> &Layers) {
 
 	Type *LayerTy = NULL;
 	int FieldIdx = -1;
@@ -468,52 +535,83 @@ bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
 #else
 	CV = NULL;
 #endif
+	size_t LayerKey = CH;
+	while (CV) {
+		size_t TH = typeHash(LayerTy);
+		Layers.push_back(make_pair(TH, FieldIdx));
+		LayerKey = hash_combine(LayerKey, TH, FieldIdx);
+		CV = nextLayerBaseType(CV, LayerTy, FieldIdx, DL);
+	}
+	return LayerKey;
+}
+
+bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
+
+	if (!FuncIDSetsBuilt)
+		buildFuncIDSets();
+
+	// Initial set: first-layer results. FS1 refers to either the
+	// first-layer set or CurFS, so that no set is copied from the maps.
+	size_t CH = callHash(CI);
+	auto sit = sigFuncIDsMap.find(CH);
+	if (sit == sigFuncIDsMap.end() || sit->second.size() == 0) {
+		// No need to go through MLTA if the first layer is empty
+		return false;
+	}
+
+	// Calls with the same signature and the same layers have the
+	// same targets, so the resolution is cached with the layer chain
+	// as the key.
+	SmallVector<pair<size_t, int>, 4> Layers;
+	size_t LayerKey = collectLayers(CI, CH, Layers);
+	int FieldIdx = -1;
+
+	{
+		lock_guard<mutex> Lock(CacheMutex);
+		auto cit = MLTACalleesMap.find(LayerKey);
+		if (cit != MLTACalleesMap.end()) {
+			FS = cit->second;
+			return true;
+		}
+	}
+
+	const FuncIDSet *FS1 = &sit->second;
+	FuncIDSet CurFS, FST;
 
 	int LayerNo = 1;
-	while (CV) {
+	for (auto &Layer : Layers) {
+		size_t TH = Layer.first;
+		FieldIdx = Layer.second;
+
 		// Step 1: ensure the type hasn't escaped
 #if 1
-		if ((typeEscapeSet.find(typeHash(LayerTy)) != typeEscapeSet.end()) || 
-				(typeEscapeSet.find(typeIdxHash(LayerTy, FieldIdx)) !=
+		if ((typeEscapeSet.find(TH) != typeEscapeSet.end()) || 
+				(typeEscapeSet.find(hashIdxHash(TH, FieldIdx)) !=
 				 typeEscapeSet.end())) {
 
 			break;
 		}
 #endif
 
-		// Step 2: get the funcset and merge
+		// Step 2: get the funcset and merge. The funcsets of
+		// transitted types are already merged by closeTypeTransits().
 		++LayerNo;
-		FS2 = typeFuncsMap[typeIdxHash(LayerTy, FieldIdx)];
-		FST.clear();
-		funcSetIntersection(FS1, FS2, FST);
+		FuncIDSet::intersect(*FS1, getTypeFuncIDs(
+					hashIdxHash(TH, FieldIdx)), FST);
 
-		// Step 3: get transitted funcsets and merge
-		// NOTE: this nested loop can be slow
-#if 1
-		unsigned TH = typeHash(LayerTy);
-		list<unsigned> LT;
-		LT.push_back(TH);
-		while (!LT.empty()) {
-			unsigned CT = LT.front();
-			LT.pop_front();
-
-			for (auto H : typeTransitMap[CT]) {
-				FS2 = typeFuncsMap[hashIdxHash(H, FieldIdx)];
-				FST.clear();
-				funcSetIntersection(FS1, FS2, FST);
-				if (FST.size() != 0)
-					FS1 = FST;
-			}
+		// Step 3: go to a lower layer
+		if (FST.size() != 0) {
+			CurFS.swap(FST);
+			FS1 = &CurFS;
 		}
-#endif
-
-		// Step 4: go to a lower layer
-		CV = nextLayerBaseType(CV, LayerTy, FieldIdx, DL);
-		if (FST.size() != 0)
-			FS1 = FST;
 	}
 
-	FS = FS1;
+	for (uint32_t ID : *FS1)
+		FS.insert(Ctx->IDFuncs[ID]);
+	{
+		lock_guard<mutex> Lock(CacheMutex);
+		MLTACalleesMap[LayerKey] = FS;
+	}
 #if 0
 	if (LayerNo > 1 && FS.size()) {
 		OP<<"[CallGraph] Indirect call: "<<*CI<<"\n";
@@ -528,12 +626,100 @@ bool CallGraphPass::findCalleesWithMLTA(CallInst *CI, FuncSet &FS) {
 	return true;
 }
 
-bool CallGraphPass::doInitialization(Module *M) {
+// Benchmark the set intersections of MLTA on the indirect calls of
+// the loaded modules: pointer sets (as copied from the type maps)
+// versus sorted dense-ID arrays. The results are compared as well.
+void CallGraphPass::benchmarkMLTA() {
+
+	if (!FuncIDSetsBuilt)
+		buildFuncIDSets();
+
+	// Collect <first-layer, second-layer> set pairs of all layers
+	vector<pair<size_t, size_t>> SetPairs;
+	for (CallInst *CI : Ctx->IndirectCallInsts) {
+		size_t CH = callHash(CI);
+		if (Ctx->sigFuncsMap.find(CH) == Ctx->sigFuncsMap.end())
+			continue;
+		Type *LayerTy = NULL;
+		int FieldIdx = -1;
+		Value *CV = nextLayerBaseType(CI->getCalledValue(),
+				LayerTy, FieldIdx, DL);
+		while (CV) {
+			SetPairs.push_back(make_pair(CH, typeIdxHash(LayerTy, FieldIdx)));
+			CV = nextLayerBaseType(CV, LayerTy, FieldIdx, DL);
+		}
+	}
+
+	static const FuncSet EmptyFuncSet;
+	size_t PtrResults = 0, IDResults = 0, Mismatches = 0;
+
+	auto PtrStart = chrono::steady_clock::now();
+	for (auto &SP : SetPairs) {
+		FuncSet FS1 = Ctx->sigFuncsMap[SP.first];
+		auto it = typeFuncsMap.find(SP.second);
+		FuncSet FS2 = (it == typeFuncsMap.end()) ? EmptyFuncSet : it->second;
+		FuncSet FST;
+		funcSetIntersection(FS1, FS2, FST);
+		PtrResults += FST.size();
+	}
+	auto PtrEnd = chrono::steady_clock::now();
+
+	FuncIDSet FST;
+	for (auto &SP : SetPairs) {
+		FuncIDSet::intersect(sigFuncIDsMap[SP.first],
+				getTypeFuncIDs(SP.second), FST);
+		IDResults += FST.size();
+	}
+	auto IDEnd = chrono::steady_clock::now();
+
+	// Verify that both representations agree
+	for (auto &SP : SetPairs) {
+		FuncSet FS2, FSP;
+		auto it = typeFuncsMap.find(SP.second);
+		if (it != typeFuncsMap.end())
+			FS2 = it->second;
+		funcSetIntersection(Ctx->sigFuncsMap[SP.first], FS2, FSP);
+		FuncIDSet::intersect(sigFuncIDsMap[SP.first],
+				getTypeFuncIDs(SP.second), FST);
+		if (FSP.size() != FST.size()) {
+			++Mismatches;
+			continue;
+		}
+		for (uint32_t ID : FST) {
+			if (!FSP.count(Ctx->IDFuncs[ID])) {
+				++Mismatches;
+				break;
+			}
+		}
+	}
+
+	auto PtrUS = chrono::duration_cast<chrono::microseconds>(
+			PtrEnd - PtrStart).count();
+	auto IDUS = chrono::duration_cast<chrono::microseconds>(
+			IDEnd - PtrEnd).count();
+	OP << "[CallGraph] MLTA intersection benchmark over "
+		<< Ctx->IndirectCallInsts.size() << " indirect calls, "
+		<< SetPairs.size() << " layers\n";
+	OP << "\tPointer sets:  " << PtrUS << " us, "
+		<< PtrResults << " targets\n";
+	OP << "\tDense-ID sets: " << IDUS << " us, "
+		<< IDResults << " targets\n";
+	OP << "\tMismatches: " << Mismatches << "\n";
+}
+
+void CallGraphPass::setModuleLayout(Module *M) {
 
 	DL = &(M->getDataLayout());
 	CurrentLayout = DL;
 	Int8PtrTy = Type::getInt8PtrTy(M->getContext());
 	IntPtrTy = DL->getIntPtrType(M->getContext());
+}
+
+// Collect the type maps of the module, and record its functions in
+// MF. Only members of this pass instance are updated.
+void CallGraphPass::initModule(Module *M, ModuleFuncs &MF) {
+
+	setModuleLayout(M);
 
 	//
 	// Iterate and process globals
@@ -572,34 +758,96 @@ bool CallGraphPass::doInitialization(Module *M) {
 		}
 
 		// Collect address-taken functions.
-		if (F.hasAddressTaken()) {
-			Ctx->AddressTakenFuncs.insert(&F);
-			Ctx->sigFuncsMap[funcHash(&F, false)].insert(&F);
-		}
+		if (F.hasAddressTaken())
+			MF.AddrTakenFuncs.push_back(make_pair(funcHash(&F, false), &F));
 
 		// Collect global function definitions.
 		if (F.hasExternalLinkage() && !F.empty()) {
 			// External linkage always ends up with the function name.
-			StringRef FName = F.getName();
+			string FName = F.getName().str();
 			// Special case: make the names of syscalls consistent.
-			if (FName.startswith("SyS_"))
-				FName = StringRef("sys_" + FName.str().substr(4));
+			if (StringRef(FName).startswith("SyS_"))
+				FName = "sys_" + FName.substr(4);
 
 			// Map functions to their names.
-			Ctx->GlobalFuncs[FName] = &F;
+			MF.GlobalFuncs.push_back(make_pair(FName, &F));
 		}
 
 		// Keep a single copy for same functions (inline functions)
-		size_t fh = funcHash(&F);
-		if (Ctx->UnifiedFuncMap.find(fh) == Ctx->UnifiedFuncMap.end()) {
-			Ctx->UnifiedFuncMap[fh] = &F;
-			Ctx->UnifiedFuncSet.insert(&F);
+		MF.UnifiedFuncs.push_back(make_pair(funcHash(&F), &F));
+	}
+}
 
-			if (F.hasAddressTaken()) {
-				Ctx->sigFuncsMap[funcHash(&F, false)].insert(&F);
-			}
+// Add the functions recorded by initModule() to the global context.
+// Calling this in module order gives the same results as a serial
+// initialization: the last definition of a global name wins, and the
+// first copy of a unified function is kept.
+void CallGraphPass::addModuleFuncs(ModuleFuncs &MF) {
+
+	for (auto &AF : MF.AddrTakenFuncs) {
+		Ctx->AddressTakenFuncs.insert(AF.second);
+		Ctx->sigFuncsMap[AF.first].insert(AF.second);
+	}
+
+	for (auto &GF : MF.GlobalFuncs)
+		Ctx->GlobalFuncs[GF.first] = GF.second;
+
+	for (auto &UF : MF.UnifiedFuncs) {
+		if (Ctx->UnifiedFuncMap.find(UF.first) == Ctx->UnifiedFuncMap.end()) {
+			Ctx->UnifiedFuncMap[UF.first] = UF.second;
+			Ctx->UnifiedFuncSet.insert(UF.second);
 		}
 	}
+}
+
+void CallGraphPass::mergeTypeMaps(CallGraphPass &Other) {
+
+	for (auto &TF : Other.typeFuncsMap)
+		typeFuncsMap[TF.first].insert(TF.second.begin(), TF.second.end());
+	for (auto &TC : Other.typeConfineMap)
+		typeConfineMap[TC.first].insert(TC.second.begin(), TC.second.end());
+	for (auto &TT : Other.typeTransitMap)
+		typeTransitMap[TT.first].insert(TT.second.begin(), TT.second.end());
+	typeEscapeSet.insert(Other.typeEscapeSet.begin(),
+			Other.typeEscapeSet.end());
+	for (auto &TF : Other.typeFieldsMap)
+		typeFieldsMap[TF.first].insert(TF.second.begin(), TF.second.end());
+}
+
+// Initialize the module with its own pass instance, keeping its type
+// maps and function records apart from the global ones. The input
+// file is hashed first, so that a later change of the file is seen.
+unique_ptr<CallGraphPass::ModuleFacts> CallGraphPass::initModuleFacts(
+		Module *M) {
+
+	unique_ptr<ModuleFacts> MFacts = make_unique<ModuleFacts>();
+	auto nit = Ctx->ModuleMaps.find(M);
+	MFacts->InputHash = (nit != Ctx->ModuleMaps.end()) ?
+		hashInputFile(nit->second) : 0;
+	MFacts->Types = make_unique<CallGraphPass>(Ctx);
+	MFacts->Types->initModule(M, MFacts->Funcs);
+	return MFacts;
+}
+
+void CallGraphPass::addModuleFacts(ModuleFacts &MFacts) {
+
+	mergeTypeMaps(*MFacts.Types);
+	addModuleFuncs(MFacts.Funcs);
+}
+
+bool CallGraphPass::doInitialization(Module *M) {
+
+	if (KeepModuleFacts) {
+		unique_ptr<ModuleFacts> MFacts = initModuleFacts(M);
+		addModuleFacts(*MFacts);
+		ModuleFactsMap[M] = std::move(MFacts);
+		setModuleLayout(M);
+		return false;
+	}
+
+	ModuleFuncs MF;
+	initModule(M, MF);
+	addModuleFuncs(MF);
 
 	return false;
 }
@@ -609,7 +857,11 @@ bool CallGraphPass::doFinalization(Module *M) {
 	return false;
 }
 
-bool CallGraphPass::doModulePass(Module *M) {
+// Find the callees of the calls in the module. The global context
+// is only read.
+void CallGraphPass::collectModuleCalls(Module *M, ModuleCalls &MC) {
+
+	CurrentLayout = &(M->getDataLayout());
 
 	// Use type-analysis to concervatively find possible targets of 
 	// indirect calls.
@@ -622,63 +874,161 @@ bool CallGraphPass::doModulePass(Module *M) {
 		if(Ctx->UnifiedFuncSet.find(F) == Ctx->UnifiedFuncSet.end())
 			continue;
 
-		// Unroll loops
-#ifdef UNROLL_LOOP_ONCE
-		unrollLoops(F);
-#endif
-
 		// Collect callers and callees
 		for (inst_iterator i = inst_begin(F), e = inst_end(F); 
 				i != e; ++i) {
 			// Map callsite to possible callees.
 			if (CallInst *CI = dyn_cast<CallInst>(&*i)) {
-
-				CallSite CS(CI);
 				FuncSet FS;
-				Function *CF = CI->getCalledFunction();
-				Value *CV = CI->getCalledValue();
-				// Indirect call
-				if (CS.isIndirectCall()) {
+				// Save called values for future uses.
+				if (findCallees(CI, FS))
+					MC.IndirectCallInsts.push_back(CI);
+				MC.Callees.push_back(make_pair(CI, FS));
+			}
+		}
+	}
+}
+
+// Find the potential callees of the call. Returns true if the call
+// is indirect.
+bool CallGraphPass::findCallees(CallInst *CI, FuncSet &FS) {
+
+	CallSite CS(CI);
+	Function *CF = CI->getCalledFunction();
+	// Indirect call
+	if (CS.isIndirectCall()) {
 #ifdef MLTA_FOR_INDIRECT_CALL  
-					findCalleesWithMLTA(CI, FS);
+		findCalleesWithMLTA(CI, FS);
 #elif SOUND_MODE
-					findCalleesWithType(CI, FS);
+		findCalleesWithType(CI, FS);
 #endif
+		return true;
+	}
 
-					for (Function *Callee : FS)
-						Ctx->Callers[Callee].insert(CI);
-
-					// Save called values for future uses.
-					Ctx->IndirectCallInsts.push_back(CI);
-				}
-				// Direct call
-				else {
-					// not InlineAsm
-					if (CF) {
-						// Call external functions
-						if (CF->empty()) {
-							StringRef FName = CF->getName();
-							if (FName.startswith("SyS_"))
-								FName = StringRef("sys_" + FName.str().substr(4));
-							if (Function *GF = Ctx->GlobalFuncs[FName])
-								CF = GF;
-						}
-						// Use unified function
-						size_t fh = funcHash(CF);
-						CF = Ctx->UnifiedFuncMap[fh];
-						if (CF) {
-							FS.insert(CF);
-							Ctx->Callers[CF].insert(CI);
-						}
-					}
-					// InlineAsm
-					else {
-					}
-				}
-				Ctx->Callees[CI] = FS;
-			}
+	// Direct call, not InlineAsm
+	if (CF) {
+		// Call external functions
+		if (CF->empty()) {
+			string FName = CF->getName().str();
+			if (StringRef(FName).startswith("SyS_"))
+				FName = "sys_" + FName.substr(4);
+			auto git = Ctx->GlobalFuncs.find(FName);
+			if (git != Ctx->GlobalFuncs.end() && git->second)
+				CF = git->second;
 		}
+		// Use unified function
+		size_t fh = funcHash(CF);
+		auto uit = Ctx->UnifiedFuncMap.find(fh);
+		CF = (uit != Ctx->UnifiedFuncMap.end()) ?
+			uit->second : NULL;
+		if (CF)
+			FS.insert(CF);
 	}
+	return false;
+}
+
+// Add the call edges found by collectModuleCalls() to the call
+// graph, where equal callee sets are shared
+void CallGraphPass::addModuleCalls(ModuleCalls &MC) {
+
+	for (auto &CE : MC.Callees) {
+		CallSite CS(CE.first);
+		Ctx->CallGraph.addCallSite(CE.first, CE.second,
+				CS.isIndirectCall());
+	}
+	Ctx->IndirectCallInsts.insert(Ctx->IndirectCallInsts.end(),
+			MC.IndirectCallInsts.begin(), MC.IndirectCallInsts.end());
+}
+
+bool CallGraphPass::doModulePass(Module *M) {
+
+	ModuleCalls MC;
+	collectModuleCalls(M, MC);
+	addModuleCalls(MC);
 
 	return false;
 }
+
+// Build the call graph with NumThreads threads. Each thread
+// initializes modules with its own pass instance; the type maps are
+// merged afterwards and the function records are added in module
+// order. Callees are then found in parallel with the merged maps, and
+// added in module order as well, so the call graph is the same as the
+// one built serially.
+void CallGraphPass::runParallel(ModuleList &modules, unsigned NumThreads) {
+
+	OP << "[" << ID << "] Initializing " << modules.size()
+		<< " modules with " << NumThreads << " threads\n";
+
+	vector<Module *> Modules;
+	for (auto &MP : modules)
+		Modules.push_back(MP.first);
+
+	if (KeepModuleFacts) {
+		// One pass instance per module, kept for updates
+		vector<unique_ptr<ModuleFacts>> Facts(Modules.size());
+		parallelFor(Modules.size(), NumThreads, [&](size_t i, unsigned t) {
+			Facts[i] = initModuleFacts(Modules[i]);
+		});
+		for (size_t i = 0; i < Modules.size(); ++i) {
+			addModuleFacts(*Facts[i]);
+			ModuleFactsMap[Modules[i]] = std::move(Facts[i]);
+		}
+	}
+	else {
+		vector<unique_ptr<CallGraphPass>> Workers;
+		for (unsigned t = 0; t < NumThreads; ++t)
+			Workers.push_back(make_unique<CallGraphPass>(Ctx));
+
+		vector<ModuleFuncs> MFs(Modules.size());
+		parallelFor(Modules.size(), NumThreads, [&](size_t i, unsigned t) {
+			Workers[t]->initModule(Modules[i], MFs[i]);
+		});
+
+		for (auto &W : Workers)
+			mergeTypeMaps(*W);
+		Workers.clear();
+		for (auto &MF : MFs)
+			addModuleFuncs(MF);
+		MFs.clear();
+	}
+
+	// The layout of the last module is kept, as in a serial pass
+	if (!Modules.empty())
+		setModuleLayout(Modules.back());
+
+	// Build the lazily-built lookup structures before sharing them
+#ifdef MLTA_FOR_INDIRECT_CALL
+	buildFuncIDSets();
+#elif SOUND_MODE
+	buildSigBuckets();
+#endif
+
+	OP << "[" << ID << "] Finding callees\n";
+	vector<ModuleCalls> MCs(Modules.size());
+	parallelFor(Modules.size(), NumThreads, [&](size_t i, unsigned t) {
+		collectModuleCalls(Modules[i], MCs[i]);
+	});
+	for (auto &MC : MCs)
+		addModuleCalls(MC);
+
+	if (!Modules.empty())
+		CurrentLayout = &(Modules.back()->getDataLayout());
+
+	OP << "[" << ID << "] Done!\n\n";
+}
+
+void CallGraphPass::run(ModuleList &modules) {
+
+	unsigned NumThreads = getNumThreads();
+	if (NumThreads > 1 && modules.size() > 1)
+		runParallel(modules, NumThreads);
+	else
+		IterativeModulePass::run(modules);
+
+	Ctx->CallGraph.finalize();
+	OP << "[" << ID << "] " << Ctx->CallGraph.getNumCallSites()
+		<< " call sites, " << Ctx->CallGraph.getNumCalleeSets()
+		<< " distinct callee sets, " << Ctx->CallGraph.getNumEdges()
+		<< " call edges\n";
+}
@@ -2,6 +2,11 @@
 #define CALL_GRAPH_H
 
 #include "Analyzer.h"
+#include "FuncIDSet.h"
+
+#include <llvm/ADT/DenseSet.h>
+
+#include <mutex>
 
 class CallGraphPass : public IterativeModulePass {
 
@@ -12,21 +17,100 @@ class CallGraphPass : public IterativeModulePass {
 		// long interger type
 		Type *IntPtrTy;
 
-		static DenseMap<size_t, FuncSet>typeFuncsMap;
-		static unordered_map<size_t, set<size_t>>typeConfineMap;
-		static unordered_map<size_t, set<size_t>>typeTransitMap;
-		static set<size_t>typeEscapeSet;
+		// Type maps collected by doInitialization. They are members,
+		// so that modules can be initialized in parallel with one
+		// pass instance per thread (see mergeTypeMaps()).
+		DenseMap<size_t, FuncSet>typeFuncsMap;
+		unordered_map<size_t, set<size_t>>typeConfineMap;
+		unordered_map<size_t, set<size_t>>typeTransitMap;
+		set<size_t>typeEscapeSet;
+		// Fields of a type that are assigned with functions
+		unordered_map<size_t, set<int>>typeFieldsMap;
+
+		// Dense-ID versions of sigFuncsMap and typeFuncsMap, built
+		// once all modules are initialized
+		static DenseMap<size_t, FuncIDSet>sigFuncIDsMap;
+		static DenseMap<size_t, FuncIDSet>typeFuncIDsMap;
+		static bool FuncIDSetsBuilt;
+
+		// Cached MLTA results, keyed by the hash of the call
+		// signature and the <type, field> chain of its layers
+		static DenseMap<size_t, FuncSet>MLTACalleesMap;
+
+		// Address-taken functions bucketed by arity and normalized
+		// parameter types, and the cached type-based callees of
+		// non-variadic call-site types (for SOUND_MODE)
+		static DenseMap<size_t, vector<Function *>>sigBucketMap;
+		static vector<Function *>varArgFuncs;
+		static DenseMap<FunctionType *, FuncSet>typeCalleesMap;
+		// Protects the caches above when modules are processed in
+		// parallel
+		static mutex CacheMutex;
+
+		// Function records of a module collected by doInitialization,
+		// to be added to the global context in module order
+		struct ModuleFuncs {
+			// <hash of function type, address-taken function>
+			vector<pair<size_t, Function *>> AddrTakenFuncs;
+			vector<pair<string, Function *>> GlobalFuncs;
+			// <funcHash, function>
+			vector<pair<size_t, Function *>> UnifiedFuncs;
+		};
+
+		// Call edges of a module found by doModulePass, to be added to
+		// the global context in module order
+		struct ModuleCalls {
+			vector<pair<CallInst *, FuncSet>> Callees;
+			vector<CallInst *> IndirectCallInsts;
+		};
+
+		// Contributions of a module, kept when the pass runs
+		// incrementally, so that the call graph can be updated when
+		// modules change (see CallGraphUpdate.cc)
+		struct ModuleFacts {
+			// Pass instance holding the type maps of the module
+			unique_ptr<CallGraphPass> Types;
+			ModuleFuncs Funcs;
+			// Hash of the input file the module was read from
+			uint64_t InputHash;
+		};
+		bool KeepModuleFacts;
+		DenseMap<Module *, unique_ptr<ModuleFacts>> ModuleFactsMap;
+		// Whether loadCallGraph() updated the saved call graph
+		bool Updated;
+
+		unique_ptr<ModuleFacts> initModuleFacts(Module *M);
+		void addModuleFacts(ModuleFacts &MFacts);
+		void updateModules(ModuleList &modules,
+				const vector<Module *> &Removed,
+				const vector<Module *> &Added,
+				const DenseSet<CallInst *> &StaleCalls);
+		static uint64_t hashInputFile(StringRef Path);
+		static void clearCaches();
+
+		void setModuleLayout(Module *M);
+		void initModule(Module *M, ModuleFuncs &MF);
+		void addModuleFuncs(ModuleFuncs &MF);
+		void mergeTypeMaps(CallGraphPass &Other);
+		void collectModuleCalls(Module *M, ModuleCalls &MC);
+		void addModuleCalls(ModuleCalls &MC);
+		bool findCallees(CallInst *CI, FuncSet &FS);
+		void runParallel(ModuleList &modules, unsigned NumThreads);
 
 		// Use type-based analysis to find targets of indirect calls
 		void findCalleesWithType(llvm::CallInst*, FuncSet&);
 
-		void unrollLoops(Function *F);
+		size_t paramTypeClass(Type *Ty);
+		void buildSigBuckets();
+		bool isTypeMatched(CallInst *CI, Function *F);
 
 		bool isCompositeType(Type *Ty);
 		bool typeConfineInInitializer(User *Ini);
 		bool typeConfineInStore(StoreInst *SI);
 		bool typeConfineInCast(CastInst *CastI);
 		void escapeType(Type *Ty, int Idx = -1);
+		void addTypeFunc(Type *Ty, int Idx, Function *F);
+		void closeTypeTransits();
 		void transitType(Type *ToTy, Type *FromTy,
 				int ToIdx = -1, int FromIdx = -1);
 
@@ -35,15 +119,49 @@ class CallGraphPass : public IterativeModulePass {
 
 		void funcSetIntersection(FuncSet &FS1, FuncSet &FS2,
 				FuncSet &FS); 
+		void buildFuncIDSets();
+		const FuncIDSet &getTypeFuncIDs(size_t TIH);
+		size_t collectLayers(CallInst *CI, size_t CH,
+				SmallVectorImpl<pair<size_t, int>> &Layers);
 		bool findCalleesWithMLTA(CallInst *CI, FuncSet &FS);
 
 	public:
 		CallGraphPass(GlobalContext *Ctx_)
-			: IterativeModulePass(Ctx_, "CallGraph") { }
+			: IterativeModulePass(Ctx_, "CallGraph"),
+			KeepModuleFacts(false), Updated(false) { }
 
 		virtual bool doInitialization(llvm::Module *);
 		virtual bool doFinalization(llvm::Module *);
 		virtual bool doModulePass(llvm::Module *);
+		virtual void run(ModuleList &modules);
+
+		// Keep the contributions of each module when running the pass,
+		// so that updateModules() can be used afterwards
+		void setIncremental(bool Enable) { KeepModuleFacts = Enable; }
+
+		// Update the call graph after the Removed modules were taken
+		// out of modules and the Added ones put in; a changed module
+		// is removed and added again. The removed modules must still
+		// be alive during the update. Only the call sites whose
+		// callees may have changed are resolved again.
+		void updateModules(ModuleList &modules,
+				const vector<Module *> &Removed,
+				const vector<Module *> &Added);
+
+		// Measure MLTA set intersections on the indirect calls
+		void benchmarkMLTA();
+
+		// Save the call graph, or load a saved one instead of running
+		// the pass; see CallGraphFile.cc. Saving needs the module
+		// facts. When they are kept, the saved graph is updated for
+		// the modules that changed since, and wasUpdated() is true.
+		bool saveCallGraph(const string &Path, ModuleList &modules);
+		bool loadCallGraph(const string &Path, ModuleList &modules);
+		bool wasUpdated() const { return Updated; }
+
+		// Build the call graph again from scratch, replacing the
+		// current one, and report the call sites whose callees differ
+		bool verifyCallGraph(ModuleList &modules);
 
 };
 
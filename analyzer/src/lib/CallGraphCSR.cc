@@ -0,0 +1,230 @@
+//===-- CallGraphCSR.cc - Compact global call-graph-------------===//
+//
+// This file interns the callee sets found by CallGraphPass and
+// stores the call graph as compressed sparse rows.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/ADT/Hashing.h>
+
+#include "CallGraphCSR.h"
+#include "Analyzer.h"
+
+CallGraphCSR::CallGraphCSR(GlobalContext *Ctx_)
+	: Ctx(Ctx_), NumDirectCalls(0) {
+
+	// Set 0 is the empty set
+	SetOffsets.assign(2, 0);
+}
+
+uint32_t CallGraphCSR::internCalleeSet(const SmallPtrSetImpl<Function *> &FS) {
+
+	SmallVector<uint32_t, 8> IDs;
+	for (Function *F : FS)
+		IDs.push_back(Ctx->getFuncID(F));
+	return internCalleeIDs(IDs);
+}
+
+uint32_t CallGraphCSR::internCalleeIDs(SmallVectorImpl<uint32_t> &IDs) {
+
+	if (IDs.empty())
+		return 0;
+
+	std::sort(IDs.begin(), IDs.end());
+	size_t H = hash_combine_range(IDs.begin(), IDs.end());
+
+	SmallVector<uint32_t, 1> &Cands = SetIndex[H];
+	for (uint32_t S : Cands) {
+		ArrayRef<Function *> Set = getCalleeSet(S);
+		if (Set.size() != IDs.size())
+			continue;
+		bool Same = true;
+		for (size_t i = 0; i < IDs.size() && Same; ++i)
+			Same = (Set[i] == Ctx->IDFuncs[IDs[i]]);
+		if (Same)
+			return S;
+	}
+
+	uint32_t S = SetOffsets.size() - 1;
+	for (uint32_t ID : IDs)
+		SetCol.push_back(Ctx->IDFuncs[ID]);
+	SetOffsets.push_back(SetCol.size());
+	Cands.push_back(S);
+	return S;
+}
+
+void CallGraphCSR::addCallSite(CallInst *CI,
+		const SmallPtrSetImpl<Function *> &FS, bool IsIndirect) {
+
+	PendingCall PC;
+	PC.CI = CI;
+	PC.SetID = internCalleeSet(FS);
+	PC.Resolved = FS.empty() ? NULL : *FS.begin();
+	if (IsIndirect)
+		PendingIndirect.push_back(PC);
+	else
+		PendingDirect.push_back(PC);
+}
+
+void CallGraphCSR::addCallSite(CallInst *CI, ArrayRef<Function *> Callees,
+		Function *Resolved, bool IsIndirect) {
+
+	SmallVector<uint32_t, 8> IDs;
+	for (Function *F : Callees)
+		IDs.push_back(Ctx->getFuncID(F));
+
+	PendingCall PC;
+	PC.CI = CI;
+	PC.SetID = internCalleeIDs(IDs);
+	PC.Resolved = Resolved;
+	if (IsIndirect)
+		PendingIndirect.push_back(PC);
+	else
+		PendingDirect.push_back(PC);
+}
+
+void CallGraphCSR::finalize() {
+
+	// Number call sites, direct ones first
+	NumDirectCalls = PendingDirect.size();
+	PendingDirect.insert(PendingDirect.end(),
+			PendingIndirect.begin(), PendingIndirect.end());
+	vector<PendingCall>().swap(PendingIndirect);
+	unordered_map<size_t, SmallVector<uint32_t, 1>>().swap(SetIndex);
+
+	CallIDs.clear();
+	CallIDs.reserve(PendingDirect.size());
+	IDCalls.clear();
+	CallSets.clear();
+	ResolvedCallees.clear();
+	for (auto &PC : PendingDirect) {
+		CallIDs[PC.CI] = IDCalls.size();
+		IDCalls.push_back(PC.CI);
+		CallSets.push_back(PC.SetID);
+		ResolvedCallees.push_back(PC.Resolved);
+	}
+	vector<PendingCall>().swap(PendingDirect);
+
+	buildRows();
+}
+
+void CallGraphCSR::restore(vector<CallInst *> &Calls, uint32_t NumDirect,
+		vector<uint32_t> &Sets, vector<Function *> &Resolved,
+		vector<uint32_t> &SetOffsets_, vector<Function *> &SetCol_) {
+
+	NumDirectCalls = NumDirect;
+	IDCalls.swap(Calls);
+	CallSets.swap(Sets);
+	ResolvedCallees.swap(Resolved);
+	SetOffsets.swap(SetOffsets_);
+	SetCol.swap(SetCol_);
+
+	CallIDs.clear();
+	CallIDs.reserve(IDCalls.size());
+	for (uint32_t i = 0; i < IDCalls.size(); ++i)
+		CallIDs[IDCalls[i]] = i;
+
+	buildRows();
+}
+
+// Build the reverse rows: call sites of sets and sets of functions
+void CallGraphCSR::buildRows() {
+
+	// Call sites of each set, by counting. Scanning call sites in ID
+	// order puts direct calls first in each row.
+	size_t NumSets = getNumCalleeSets();
+	vector<uint32_t> NumCalls(NumSets, 0), NumDirect(NumSets, 0);
+	for (uint32_t i = 0; i < IDCalls.size(); ++i) {
+		++NumCalls[CallSets[i]];
+		if (i < NumDirectCalls)
+			++NumDirect[CallSets[i]];
+	}
+	SetCallOffsets.assign(NumSets + 1, 0);
+	SetIndirectBegins.assign(NumSets, 0);
+	for (size_t s = 0; s < NumSets; ++s) {
+		SetCallOffsets[s + 1] = SetCallOffsets[s] + NumCalls[s];
+		SetIndirectBegins[s] = SetCallOffsets[s] + NumDirect[s];
+	}
+	SetCallCol.assign(IDCalls.size(), NULL);
+	vector<uint32_t> Pos(SetCallOffsets.begin(), SetCallOffsets.end() - 1);
+	for (uint32_t i = 0; i < IDCalls.size(); ++i)
+		SetCallCol[Pos[CallSets[i]]++] = IDCalls[i];
+
+	// Sets containing each function
+	size_t NumFuncs = Ctx->IDFuncs.size();
+	vector<uint32_t> NumFuncSets(NumFuncs, 0);
+	for (Function *F : SetCol)
+		++NumFuncSets[Ctx->FuncIDs[F]];
+	FuncSetOffsets.assign(NumFuncs + 1, 0);
+	for (size_t f = 0; f < NumFuncs; ++f)
+		FuncSetOffsets[f + 1] = FuncSetOffsets[f] + NumFuncSets[f];
+	FuncSetCol.assign(SetCol.size(), 0);
+	Pos.assign(FuncSetOffsets.begin(), FuncSetOffsets.end() - 1);
+	for (uint32_t s = 1; s < NumSets; ++s) {
+		bool Singleton = (SetOffsets[s + 1] - SetOffsets[s] == 1);
+		for (Function *F : getCalleeSet(s)) {
+			uint32_t FID = Ctx->FuncIDs[F];
+			FuncSetCol[Pos[FID]++] = s;
+			// Keep the singleton set first
+			if (Singleton && Pos[FID] - 1 != FuncSetOffsets[FID])
+				std::swap(FuncSetCol[FuncSetOffsets[FID]],
+						FuncSetCol[Pos[FID] - 1]);
+		}
+	}
+}
+
+size_t CallGraphCSR::getNumEdges() const {
+
+	size_t NumEdges = 0;
+	for (uint32_t S : CallSets)
+		NumEdges += SetOffsets[S + 1] - SetOffsets[S];
+	return NumEdges;
+}
+
+uint32_t CallGraphCSR::getCalleeSetID(CallInst *CI) const {
+
+	auto it = CallIDs.find(CI);
+	if (it == CallIDs.end())
+		return 0;
+	return CallSets[it->second];
+}
+
+ArrayRef<Function *> CallGraphCSR::getCallees(CallInst *CI) const {
+
+	return getCalleeSet(getCalleeSetID(CI));
+}
+
+ArrayRef<uint32_t> CallGraphCSR::getFuncSets(Function *F) const {
+
+	auto it = Ctx->FuncIDs.find(F);
+	// Functions numbered after finalize() have no callers
+	if (it == Ctx->FuncIDs.end() || it->second + 1 >= FuncSetOffsets.size())
+		return ArrayRef<uint32_t>();
+	uint32_t f = it->second;
+	return makeArrayRef(FuncSetCol.data() + FuncSetOffsets[f],
+			FuncSetOffsets[f + 1] - FuncSetOffsets[f]);
+}
+
+CallGraphCSR::caller_range CallGraphCSR::getCallers(Function *F) const {
+
+	ArrayRef<uint32_t> Sets = getFuncSets(F);
+	return caller_range(caller_iterator(this, Sets.begin(), Sets.end(), false),
+			caller_iterator(this, Sets.end(), Sets.end(), false));
+}
+
+ArrayRef<CallInst *> CallGraphCSR::getDirectCallers(Function *F) const {
+
+	ArrayRef<uint32_t> Sets = getFuncSets(F);
+	if (Sets.empty() || getCalleeSet(Sets[0]).size() != 1)
+		return ArrayRef<CallInst *>();
+	uint32_t S = Sets[0];
+	return makeArrayRef(SetCallCol.data() + SetCallOffsets[S],
+			SetIndirectBegins[S] - SetCallOffsets[S]);
+}
+
+CallGraphCSR::caller_range CallGraphCSR::getIndirectCallers(Function *F) const {
+
+	ArrayRef<uint32_t> Sets = getFuncSets(F);
+	return caller_range(caller_iterator(this, Sets.begin(), Sets.end(), true),
+			caller_iterator(this, Sets.end(), Sets.end(), true));
+}
@@ -0,0 +1,192 @@
+#ifndef CALL_GRAPH_CSR_H
+#define CALL_GRAPH_CSR_H
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/iterator_range.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+struct GlobalContext;
+
+//
+// The global call graph in compressed sparse row (CSR) form. Callee
+// sets are hash-consed: each distinct set is stored once, in the
+// order of the dense function IDs of GlobalContext, and call sites
+// refer to it by a set ID. Callers of a function are found through
+// the sets containing it, rather than being expanded per callee.
+//
+// Call sites are added while building the call graph, and numbered
+// with dense IDs by finalize(), direct calls first. The "resolved"
+// callee of a call site is the first callee of the set it was added
+// with, as the analyses used to take from the front of the set.
+//
+class CallGraphCSR {
+
+	public:
+		// Iterates the call sites of a sequence of callee sets
+		class caller_iterator {
+
+			public:
+				caller_iterator() : G(NULL), SetIt(NULL), SetEnd(NULL),
+					Pos(0), End(0), IndirectOnly(false) { }
+				caller_iterator(const CallGraphCSR *G_,
+						const uint32_t *Begin, const uint32_t *End_,
+						bool IndirectOnly_)
+					: G(G_), SetIt(Begin), SetEnd(End_), Pos(0), End(0),
+					IndirectOnly(IndirectOnly_) {
+						settle();
+					}
+
+				CallInst *operator*() const { return G->SetCallCol[Pos]; }
+				caller_iterator &operator++() {
+					++Pos;
+					settle();
+					return *this;
+				}
+				bool operator==(const caller_iterator &Other) const {
+					return SetIt == Other.SetIt && Pos == Other.Pos;
+				}
+				bool operator!=(const caller_iterator &Other) const {
+					return !(*this == Other);
+				}
+
+			private:
+				const CallGraphCSR *G;
+				const uint32_t *SetIt, *SetEnd;
+				uint32_t Pos, End;
+				bool IndirectOnly;
+
+				// Move to the next set with remaining call sites
+				void settle() {
+					while (Pos == End && SetIt != SetEnd) {
+						uint32_t S = *SetIt++;
+						Pos = IndirectOnly ? G->SetIndirectBegins[S]
+							: G->SetCallOffsets[S];
+						End = G->SetCallOffsets[S + 1];
+					}
+					if (Pos == End)
+						Pos = End = ~0U;
+				}
+		};
+		typedef iterator_range<caller_iterator> caller_range;
+
+		CallGraphCSR(GlobalContext *Ctx_);
+
+		// Add a call site with its callees; call sites can only be
+		// looked up after finalize()
+		void addCallSite(CallInst *CI, const SmallPtrSetImpl<Function *> &FS,
+				bool IsIndirect);
+		// Add a call site with the callees and the resolved callee of
+		// a call site of another graph
+		void addCallSite(CallInst *CI, ArrayRef<Function *> Callees,
+				Function *Resolved, bool IsIndirect);
+		void finalize();
+
+		// Rebuild the graph from the rows of a saved one (see
+		// CallGraphFile.cc). Calls are ordered by ID; callee sets are
+		// given by SetOffsets and SetCol as in the graph itself.
+		void restore(vector<CallInst *> &Calls, uint32_t NumDirect,
+				vector<uint32_t> &Sets, vector<Function *> &Resolved,
+				vector<uint32_t> &SetOffsets_, vector<Function *> &SetCol_);
+
+		// Potential callees of the call site, ordered by function ID
+		ArrayRef<Function *> getCallees(CallInst *CI) const;
+
+		// The first callee of the call site; NULL if it has none
+		Function *getResolvedCallee(CallInst *CI) const {
+			auto it = CallIDs.find(CI);
+			if (it == CallIDs.end())
+				return NULL;
+			return ResolvedCallees[it->second];
+		}
+
+		// Potential caller instructions of the function
+		caller_range getCallers(Function *F) const;
+		ArrayRef<CallInst *> getDirectCallers(Function *F) const;
+		caller_range getIndirectCallers(Function *F) const;
+
+		bool hasCallers(Function *F) const {
+			return !getFuncSets(F).empty();
+		}
+
+		bool isIndirectCall(CallInst *CI) const {
+			auto it = CallIDs.find(CI);
+			return it != CallIDs.end() && it->second >= NumDirectCalls;
+		}
+
+		// ID of the callee set of the call site; 0 is the empty set
+		uint32_t getCalleeSetID(CallInst *CI) const;
+		ArrayRef<Function *> getCalleeSet(uint32_t S) const {
+			return makeArrayRef(SetCol.data() + SetOffsets[S],
+					SetOffsets[S + 1] - SetOffsets[S]);
+		}
+		// Number of call sites sharing the set
+		uint32_t getCalleeSetRefs(uint32_t S) const {
+			return SetCallOffsets[S + 1] - SetCallOffsets[S];
+		}
+
+		// Call sites by dense ID
+		size_t getNumCallSites() const { return IDCalls.size(); }
+		uint32_t getNumDirectCalls() const { return NumDirectCalls; }
+		CallInst *getCallSite(uint32_t ID) const { return IDCalls[ID]; }
+		uint32_t getCallSetID(uint32_t ID) const { return CallSets[ID]; }
+		Function *getResolvedCalleeOf(uint32_t ID) const {
+			return ResolvedCallees[ID];
+		}
+
+		size_t getNumCalleeSets() const { return SetOffsets.size() - 1; }
+		// Number of call edges, counted per call site
+		size_t getNumEdges() const;
+
+	private:
+		GlobalContext *Ctx;
+
+		// Interned callee sets: set i is SetCol[SetOffsets[i],
+		// SetOffsets[i + 1]). SetIndex maps the hash of a set to the
+		// sets with that hash, and is only used while adding.
+		vector<uint32_t> SetOffsets;
+		vector<Function *> SetCol;
+		unordered_map<size_t, SmallVector<uint32_t, 1>> SetIndex;
+
+		// Call sites added but not yet numbered: <call, set, resolved>
+		struct PendingCall {
+			CallInst *CI;
+			uint32_t SetID;
+			Function *Resolved;
+		};
+		vector<PendingCall> PendingDirect, PendingIndirect;
+
+		// Call site <-> dense ID; IDs below NumDirectCalls are direct
+		DenseMap<CallInst *, uint32_t> CallIDs;
+		vector<CallInst *> IDCalls;
+		uint32_t NumDirectCalls;
+		vector<uint32_t> CallSets;
+		vector<Function *> ResolvedCallees;
+
+		// Call sites of set i, ordered by ID, are SetCallCol[
+		// SetCallOffsets[i], SetCallOffsets[i + 1]); the indirect ones
+		// start at SetIndirectBegins[i]
+		vector<uint32_t> SetCallOffsets;
+		vector<uint32_t> SetIndirectBegins;
+		vector<CallInst *> SetCallCol;
+
+		// Sets containing function i are FuncSetCol[FuncSetOffsets[i],
+		// FuncSetOffsets[i + 1]). The set {F} of direct calls to F, if
+		// any, comes first.
+		vector<uint32_t> FuncSetOffsets;
+		vector<uint32_t> FuncSetCol;
+
+		uint32_t internCalleeSet(const SmallPtrSetImpl<Function *> &FS);
+		uint32_t internCalleeIDs(SmallVectorImpl<uint32_t> &IDs);
+		void buildRows();
+		ArrayRef<uint32_t> getFuncSets(Function *F) const;
+};
+
+#endif
@@ -0,0 +1,543 @@
+//===-- CallGraphFile.cc - Save and load the call-graph---------===//
+//
+// This file writes the results of CallGraphPass to a versioned
+// binary file, and reads them back in a later run, so the call graph
+// is not built again. The facts of each module are saved with a hash
+// of its input file; when some input files changed, the saved call
+// graph is updated for them (see CallGraphUpdate.cc).
+//
+// Functions are identified by the index of their module in the
+// saved module list and by their names; call sites by their caller
+// and their position among the calls of the caller. The file is
+// read in place from a (memory-mapped) buffer.
+//
+// The layout is described in CallGraphFile.h.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/IR/InstIterator.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/ADT/StringMap.h>
+
+#include "CallGraph.h"
+#include "CallGraphFile.h"
+#include "Config.h"
+#include "Common.h"
+
+// Configurations that change the call graph
+static const char *CGConfigTag = ""
+#ifdef MLTA_FOR_INDIRECT_CALL
+	"mlta;"
+#endif
+#ifdef SOUND_MODE
+	"sound;"
+#endif
+#ifdef ONE_LAYER_MLTA
+	"one-layer;"
+#endif
+	;
+
+// Hash of the name, size and modification time of an input file
+uint64_t CallGraphPass::hashInputFile(StringRef Path) {
+
+	sys::fs::file_status Status;
+	uint64_t Size = 0, MTime = 0;
+	if (!sys::fs::status(Path, Status)) {
+		Size = Status.getSize();
+		MTime = Status.getLastModificationTime()
+			.time_since_epoch().count();
+	}
+	return hash_combine(Path, Size, MTime);
+}
+
+
+// Hash of the file version and the configuration
+static uint64_t hashConfig() {
+
+	return hash_combine(CG_FILE_VERSION, StringRef(CGConfigTag));
+}
+
+bool CallGraphPass::saveCallGraph(const string &Path, ModuleList &modules) {
+
+	CallGraphCSR &CG = Ctx->CallGraph;
+
+	DenseMap<Module *, uint32_t> ModuleIdx;
+	for (uint32_t i = 0; i < modules.size(); ++i) {
+		if (!ModuleFactsMap.count(modules[i].first)) {
+			OP << "[" << ID << "] Cannot save the call graph: "
+				<< "the module facts are not kept\n";
+			return false;
+		}
+		ModuleIdx[modules[i].first] = i;
+	}
+
+	// Number the callers of call sites as well, and the position of
+	// each call site among the calls of its caller
+	DenseMap<Function *, bool> Numbered;
+	DenseMap<CallInst *, uint32_t> CallNo;
+	for (uint32_t i = 0; i < CG.getNumCallSites(); ++i) {
+		Function *F = CG.getCallSite(i)->getFunction();
+		Ctx->getFuncID(F);
+		if (Numbered[F])
+			continue;
+		Numbered[F] = true;
+		uint32_t No = 0;
+		for (inst_iterator ii = inst_begin(F), e = inst_end(F); ii != e; ++ii)
+			if (CallInst *CI = dyn_cast<CallInst>(&*ii))
+				CallNo[CI] = No++;
+	}
+	for (auto &MP : modules) {
+		ModuleFacts &MFacts = *ModuleFactsMap[MP.first];
+		for (auto &AF : MFacts.Funcs.AddrTakenFuncs)
+			Ctx->getFuncID(AF.second);
+		for (auto &GF : MFacts.Funcs.GlobalFuncs)
+			Ctx->getFuncID(GF.second);
+		for (auto &UF : MFacts.Funcs.UnifiedFuncs)
+			Ctx->getFuncID(UF.second);
+		for (auto &TF : MFacts.Types->typeFuncsMap)
+			for (Function *F : TF.second)
+				Ctx->getFuncID(F);
+	}
+
+	for (Function *F : Ctx->IDFuncs) {
+		if (!F->hasName()) {
+			OP << "[" << ID << "] Cannot save the call graph: "
+				<< "unnamed function\n";
+			return false;
+		}
+	}
+
+	string TmpPath = Path + ".tmp";
+	error_code EC;
+	raw_fd_ostream OS(TmpPath, EC, sys::fs::OF_None);
+	if (EC) {
+		OP << "[" << ID << "] Cannot write " << TmpPath << ": "
+			<< EC.message() << "\n";
+		return false;
+	}
+	CGFileWriter W(OS);
+
+	// Header
+	W.u32(CG_FILE_MAGIC);
+	W.u32(CG_FILE_VERSION);
+	W.u64(hashConfig());
+	W.u32(modules.size());
+
+	// Modules, with the hashes of the inputs their facts came from
+	for (auto &MP : modules) {
+		W.str(MP.second);
+		W.u64(ModuleFactsMap[MP.first]->InputHash);
+	}
+
+	// Functions
+	W.u32(Ctx->IDFuncs.size());
+	for (Function *F : Ctx->IDFuncs) {
+		W.u32(ModuleIdx[F->getParent()]);
+		W.str(F->getName());
+	}
+
+	// Callee sets
+	W.u32(CG.getNumCalleeSets());
+	for (uint32_t s = 0; s < CG.getNumCalleeSets(); ++s) {
+		ArrayRef<Function *> Set = CG.getCalleeSet(s);
+		W.u32(Set.size());
+		for (Function *F : Set)
+			W.u32(Ctx->FuncIDs[F]);
+	}
+
+	// Call sites: <caller, position, callee set, resolved callee + 1>
+	W.u32(CG.getNumCallSites());
+	W.u32(CG.getNumDirectCalls());
+	for (uint32_t i = 0; i < CG.getNumCallSites(); ++i) {
+		CallInst *CI = CG.getCallSite(i);
+		Function *RF = CG.getResolvedCalleeOf(i);
+		W.u32(Ctx->FuncIDs[CI->getFunction()]);
+		W.u32(CallNo[CI]);
+		W.u32(CG.getCallSetID(i));
+		W.u32(RF ? Ctx->FuncIDs[RF] + 1 : 0);
+	}
+
+	auto writeFuncsMap = [&](DenseMap<size_t, FuncSet> &Map) {
+		W.u32(Map.size());
+		for (auto &MF : Map) {
+			W.u64(MF.first);
+			W.u32(MF.second.size());
+			for (Function *F : MF.second)
+				W.u32(Ctx->FuncIDs[F]);
+		}
+	};
+	auto writeHashesMap = [&](unordered_map<size_t, set<size_t>> &Map) {
+		W.u32(Map.size());
+		for (auto &MH : Map) {
+			W.u64(MH.first);
+			W.u32(MH.second.size());
+			for (size_t H : MH.second)
+				W.u64(H);
+		}
+	};
+
+	// Module facts
+	for (auto &MP : modules) {
+		ModuleFacts &MFacts = *ModuleFactsMap[MP.first];
+		ModuleFuncs &MF = MFacts.Funcs;
+		CallGraphPass &T = *MFacts.Types;
+
+		W.u32(MF.AddrTakenFuncs.size());
+		for (auto &AF : MF.AddrTakenFuncs) {
+			W.u64(AF.first);
+			W.u32(Ctx->FuncIDs[AF.second]);
+		}
+		W.u32(MF.GlobalFuncs.size());
+		for (auto &GF : MF.GlobalFuncs) {
+			W.str(GF.first);
+			W.u32(Ctx->FuncIDs[GF.second]);
+		}
+		W.u32(MF.UnifiedFuncs.size());
+		for (auto &UF : MF.UnifiedFuncs) {
+			W.u64(UF.first);
+			W.u32(Ctx->FuncIDs[UF.second]);
+		}
+
+		writeFuncsMap(T.typeFuncsMap);
+		writeHashesMap(T.typeConfineMap);
+		writeHashesMap(T.typeTransitMap);
+		W.u32(T.typeEscapeSet.size());
+		for (size_t H : T.typeEscapeSet)
+			W.u64(H);
+		W.u32(T.typeFieldsMap.size());
+		for (auto &TF : T.typeFieldsMap) {
+			W.u64(TF.first);
+			W.u32(TF.second.size());
+			for (int Idx : TF.second)
+				W.u32(Idx);
+		}
+	}
+
+	// Query index: source locations of functions and call sites. File
+	// 0 is the unknown file.
+	vector<StringRef> Files(1, "");
+	StringMap<uint32_t> FileIdx;
+	vector<pair<uint32_t, uint32_t>> FuncLocs, CallLocs;
+	auto addLoc = [&](StringRef File, unsigned Line,
+			vector<pair<uint32_t, uint32_t>> &Locs) {
+		if (File.empty()) {
+			Locs.push_back(make_pair(0, 0));
+			return;
+		}
+		auto Ins = FileIdx.insert(make_pair(File, Files.size()));
+		if (Ins.second)
+			Files.push_back(File);
+		Locs.push_back(make_pair(Ins.first->second, Line));
+	};
+	for (Function *F : Ctx->IDFuncs) {
+		DISubprogram *SP = F->getSubprogram();
+		addLoc(SP ? SP->getFilename() : "", SP ? SP->getLine() : 0,
+				FuncLocs);
+	}
+	for (uint32_t i = 0; i < CG.getNumCallSites(); ++i) {
+		DILocation *Loc = getSourceLocation(CG.getCallSite(i));
+		addLoc(Loc ? Loc->getFilename() : "", Loc ? Loc->getLine() : 0,
+				CallLocs);
+	}
+	W.u32(Files.size());
+	for (StringRef File : Files)
+		W.str(File);
+	for (auto &Loc : FuncLocs) {
+		W.u32(Loc.first);
+		W.u32(Loc.second);
+	}
+	for (auto &Loc : CallLocs) {
+		W.u32(Loc.first);
+		W.u32(Loc.second);
+	}
+
+	OS.close();
+	if (OS.has_error() || sys::fs::rename(TmpPath, Path)) {
+		OS.clear_error();
+		sys::fs::remove(TmpPath);
+		OP << "[" << ID << "] Cannot write " << Path << "\n";
+		return false;
+	}
+
+	OP << "[" << ID << "] Saved the call graph to " << Path << "\n";
+	return true;
+}
+
+bool CallGraphPass::loadCallGraph(const string &Path, ModuleList &modules) {
+
+	auto BufOrErr = MemoryBuffer::getFile(Path, -1,
+			/*RequiresNullTerminator=*/false);
+	if (!BufOrErr)
+		return false;
+	CGFileReader R((*BufOrErr)->getBuffer());
+
+	if (R.u32() != CG_FILE_MAGIC || R.u32() != CG_FILE_VERSION
+			|| R.u64() != hashConfig() || R.failed()) {
+		OP << "[" << ID << "] " << Path << " is outdated\n";
+		return false;
+	}
+	// Function IDs are restored as they were saved
+	if (!Ctx->IDFuncs.empty())
+		return false;
+
+#define CG_FILE_CHECK(cond)											\
+	do {																\
+		if (!(cond) || R.failed()) {									\
+			OP << "[" << ID << "] " << Path << " is invalid\n";		\
+			return false;												\
+		}																\
+	} while(0)
+
+	// Saved modules, matched with the input modules by name. Those
+	// whose input hash is unchanged are reused.
+	StringMap<Module *> NameModules;
+	for (auto &MP : modules)
+		NameModules[MP.second] = MP.first;
+	uint32_t NumSavedModules = R.count(12);
+	vector<Module *> SavedModules(NumSavedModules, NULL);
+	vector<uint64_t> SavedHashes(NumSavedModules);
+	SmallPtrSet<Module *, 8> Unchanged;
+	for (uint32_t i = 0; i < NumSavedModules; ++i) {
+		StringRef Name = R.str();
+		SavedHashes[i] = R.u64();
+		auto it = NameModules.find(Name);
+		if (it == NameModules.end())
+			continue;
+		SavedModules[i] = it->second;
+		if (SavedHashes[i] == hashInputFile(Name))
+			Unchanged.insert(it->second);
+		NameModules.erase(it);
+	}
+	CG_FILE_CHECK(!R.failed());
+
+	// Without the module facts, the call graph cannot be updated. It
+	// is also updated when the modules are reordered, as the facts
+	// are merged in module order.
+	bool AllUnchanged = (Unchanged.size() == modules.size()
+			&& NumSavedModules == modules.size());
+	for (uint32_t i = 0; i < NumSavedModules && AllUnchanged; ++i)
+		AllUnchanged = (SavedModules[i] == modules[i].first);
+	if (Unchanged.empty() || (!AllUnchanged && !KeepModuleFacts)) {
+		OP << "[" << ID << "] " << Path << " is outdated\n";
+		return false;
+	}
+
+	// Functions; those of changed or removed modules are looked up
+	// by name and may be gone
+	vector<Function *> Funcs(R.count(8));
+	for (auto &F : Funcs) {
+		uint32_t MIdx = R.u32();
+		StringRef Name = R.str();
+		CG_FILE_CHECK(MIdx < NumSavedModules);
+		Module *M = SavedModules[MIdx];
+		F = M ? M->getFunction(Name) : NULL;
+		CG_FILE_CHECK(F || !Unchanged.count(M));
+	}
+	auto readFuncID = [&]() -> Function * {
+		uint32_t FID = R.u32();
+		if (FID >= Funcs.size()) {
+			R.fail();
+			return NULL;
+		}
+		return Funcs[FID];
+	};
+
+	// Callee sets; a set with a function that is gone is stale
+	uint32_t NumSets = R.count(4);
+	CG_FILE_CHECK(NumSets > 0);
+	vector<uint32_t> SetOffsets(1, 0);
+	vector<Function *> SetCol;
+	vector<bool> StaleSets(NumSets, false);
+	for (uint32_t s = 0; s < NumSets; ++s) {
+		uint32_t N = R.count(4);
+		for (uint32_t i = 0; i < N; ++i) {
+			SetCol.push_back(readFuncID());
+			if (!SetCol.back())
+				StaleSets[s] = true;
+		}
+		CG_FILE_CHECK(!R.failed());
+		SetOffsets.push_back(SetCol.size());
+	}
+
+	// Call sites of unchanged modules; the others are found again
+	uint32_t NumCalls = R.count(16);
+	uint32_t NumDirect = R.u32();
+	CG_FILE_CHECK(NumDirect <= NumCalls);
+	DenseMap<Function *, vector<CallInst *>> FuncCalls;
+	vector<CallInst *> Calls;
+	vector<uint32_t> CallSets;
+	vector<Function *> Resolved;
+	uint32_t NumKeptDirect = 0;
+	DenseSet<CallInst *> StaleCalls;
+	for (uint32_t i = 0; i < NumCalls; ++i) {
+		uint32_t FID = R.u32();
+		uint32_t No = R.u32();
+		uint32_t SetID = R.u32();
+		uint32_t RFID = R.u32();
+		CG_FILE_CHECK(FID < Funcs.size() && SetID < NumSets
+				&& RFID <= Funcs.size());
+		Function *F = Funcs[FID];
+		if (!F || !Unchanged.count(F->getParent()))
+			continue;
+		Function *RF = RFID ? Funcs[RFID - 1] : NULL;
+
+		auto fit = FuncCalls.find(F);
+		if (fit == FuncCalls.end()) {
+			fit = FuncCalls.insert(make_pair(F, vector<CallInst *>())).first;
+			for (inst_iterator ii = inst_begin(F), e = inst_end(F);
+					ii != e; ++ii)
+				if (CallInst *CI = dyn_cast<CallInst>(&*ii))
+					fit->second.push_back(CI);
+		}
+		CG_FILE_CHECK(No < fit->second.size());
+		CallInst *CI = fit->second[No];
+		if (StaleSets[SetID] || (RFID && !RF))
+			StaleCalls.insert(CI);
+		Calls.push_back(CI);
+		CallSets.push_back(SetID);
+		Resolved.push_back(RF);
+		if (i < NumDirect)
+			++NumKeptDirect;
+	}
+
+	// Module facts; the functions that are gone are left out
+	auto readFuncsMap = [&](DenseMap<size_t, FuncSet> &Map) {
+		uint32_t N = R.count(12);
+		for (uint32_t i = 0; i < N && !R.failed(); ++i) {
+			FuncSet &FS = Map[R.u64()];
+			uint32_t M = R.count(4);
+			for (uint32_t j = 0; j < M; ++j) {
+				if (Function *F = readFuncID())
+					FS.insert(F);
+			}
+		}
+	};
+	auto readHashesMap = [&](unordered_map<size_t, set<size_t>> &Map) {
+		uint32_t N = R.count(12);
+		for (uint32_t i = 0; i < N && !R.failed(); ++i) {
+			set<size_t> &HS = Map[R.u64()];
+			uint32_t M = R.count(8);
+			for (uint32_t j = 0; j < M; ++j)
+				HS.insert(R.u64());
+		}
+	};
+	vector<unique_ptr<ModuleFacts>> Facts(NumSavedModules);
+	for (uint32_t m = 0; m < NumSavedModules; ++m) {
+		unique_ptr<ModuleFacts> MFacts = make_unique<ModuleFacts>();
+		MFacts->InputHash = SavedHashes[m];
+		MFacts->Types = make_unique<CallGraphPass>(Ctx);
+		ModuleFuncs &MF = MFacts->Funcs;
+		CallGraphPass &T = *MFacts->Types;
+
+		uint32_t N = R.count(12);
+		for (uint32_t i = 0; i < N; ++i) {
+			size_t H = R.u64();
+			if (Function *F = readFuncID())
+				MF.AddrTakenFuncs.push_back(make_pair(H, F));
+		}
+		N = R.count(8);
+		for (uint32_t i = 0; i < N; ++i) {
+			string Name = R.str().str();
+			if (Function *F = readFuncID())
+				MF.GlobalFuncs.push_back(make_pair(Name, F));
+		}
+		N = R.count(12);
+		for (uint32_t i = 0; i < N; ++i) {
+			size_t H = R.u64();
+			if (Function *F = readFuncID())
+				MF.UnifiedFuncs.push_back(make_pair(H, F));
+		}
+
+		readFuncsMap(T.typeFuncsMap);
+		readHashesMap(T.typeConfineMap);
+		readHashesMap(T.typeTransitMap);
+		N = R.count(8);
+		for (uint32_t i = 0; i < N; ++i)
+			T.typeEscapeSet.insert(R.u64());
+		N = R.count(12);
+		for (uint32_t i = 0; i < N && !R.failed(); ++i) {
+			set<int> &FS = T.typeFieldsMap[R.u64()];
+			uint32_t M = R.count(4);
+			for (uint32_t j = 0; j < M; ++j)
+				FS.insert((int)R.u32());
+		}
+		CG_FILE_CHECK(!R.failed());
+		Facts[m] = std::move(MFacts);
+	}
+
+	// The query index is not needed here
+	uint32_t NumFiles = R.count(4);
+	for (uint32_t i = 0; i < NumFiles; ++i)
+		R.str();
+	R.skip(((size_t)Funcs.size() + NumCalls) * 8);
+	CG_FILE_CHECK(R.atEnd());
+#undef CG_FILE_CHECK
+
+	//
+	// The file is valid; commit the results of the saved run
+	//
+	for (Function *F : Funcs) {
+		if (F)
+			Ctx->getFuncID(F);
+	}
+	for (uint32_t m = 0; m < NumSavedModules; ++m) {
+		addModuleFacts(*Facts[m]);
+		if (KeepModuleFacts && SavedModules[m])
+			ModuleFactsMap[SavedModules[m]] = std::move(Facts[m]);
+	}
+	Facts.clear();
+	if (!modules.empty())
+		setModuleLayout(modules.back().first);
+
+	if (AllUnchanged) {
+		Ctx->IndirectCallInsts.assign(Calls.begin() + NumDirect, Calls.end());
+		Ctx->CallGraph.restore(Calls, NumDirect, CallSets, Resolved,
+				SetOffsets, SetCol);
+
+		OP << "[" << ID << "] Loaded the call graph from " << Path << ": "
+			<< Ctx->CallGraph.getNumCallSites() << " call sites, "
+			<< Ctx->CallGraph.getNumCalleeSets() << " distinct callee sets\n";
+		return true;
+	}
+
+	// Call sites of the unchanged modules, with the callees that are
+	// still there
+	for (uint32_t i = 0; i < Calls.size(); ++i) {
+		SmallVector<Function *, 8> Callees;
+		for (uint32_t j = SetOffsets[CallSets[i]];
+				j < SetOffsets[CallSets[i] + 1]; ++j) {
+			if (SetCol[j])
+				Callees.push_back(SetCol[j]);
+		}
+		Ctx->CallGraph.addCallSite(Calls[i], Callees, Resolved[i],
+				i >= NumKeptDirect);
+		if (i >= NumKeptDirect)
+			Ctx->IndirectCallInsts.push_back(Calls[i]);
+	}
+	Ctx->CallGraph.finalize();
+#ifdef MLTA_FOR_INDIRECT_CALL
+	// The first-layer and second-layer sets of the saved run, to find
+	// the changed keys
+	buildFuncIDSets();
+#endif
+
+	// Update the graph for the changed modules: they are removed and
+	// added again, new modules are added
+	vector<Module *> Removed, Added;
+	for (Module *M : SavedModules) {
+		if (M && !Unchanged.count(M))
+			Removed.push_back(M);
+	}
+	for (auto &MP : modules) {
+		if (!Unchanged.count(MP.first))
+			Added.push_back(MP.first);
+	}
+	OP << "[" << ID << "] Loaded the call graph from " << Path << "; "
+		<< (modules.size() - Unchanged.size()) << " of " << modules.size()
+		<< " modules changed\n";
+	updateModules(modules, Removed, Added, StaleCalls);
+	Updated = true;
+	return true;
+}
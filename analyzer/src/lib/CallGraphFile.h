@@ -0,0 +1,111 @@
+#ifndef CALL_GRAPH_FILE_H
+#define CALL_GRAPH_FILE_H
+
+//
+// Format of the call-graph file written by CallGraphPass and read by
+// kanalyzer-query. All integers are in host byte order; a string is
+// its u32 length followed by its bytes. Sections, in order:
+//
+//   header:      magic, version, u64 hash of the configuration,
+//                #modules
+//   modules:     <name, u64 hash of the input file> per module
+//   functions:   #funcs, <u32 module index, name> per dense ID
+//   callee sets: #sets, <#funcs, function IDs> per set; set 0 is empty
+//   call sites:  #calls, #direct calls, <caller ID, position among
+//                the calls of the caller, set ID, resolved callee
+//                ID + 1 (0: none)> per call ID; direct calls first
+//   module facts, per module:
+//     address-taken functions: #funcs, <u64 funcHash, function ID>
+//     global functions: #funcs, <name, function ID>
+//     unified functions: #funcs, <u64 funcHash, function ID>
+//     typeFuncsMap: #entries, <u64 hash, #funcs, IDs>
+//     typeConfineMap, typeTransitMap: #entries, <u64, #hashes, u64s>
+//     typeEscapeSet: #hashes, u64s
+//     typeFieldsMap: #entries, <u64 hash, #fields, fields>
+//   query index: #files, file names; <file index, line> per function,
+//                and per call site
+//
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstring>
+
+#define CG_FILE_MAGIC 0x4743414b // "KACG"
+#define CG_FILE_VERSION 3
+
+class CGFileWriter {
+
+	public:
+		CGFileWriter(llvm::raw_ostream &OS_) : OS(OS_) { }
+
+		void u32(uint32_t V) { OS.write((const char *)&V, sizeof(V)); }
+		void u64(uint64_t V) { OS.write((const char *)&V, sizeof(V)); }
+		void str(llvm::StringRef S) {
+			u32(S.size());
+			OS << S;
+		}
+
+	private:
+		llvm::raw_ostream &OS;
+};
+
+class CGFileReader {
+
+	public:
+		CGFileReader(llvm::StringRef Buf)
+			: P(Buf.begin()), End(Buf.end()), Failed(false) { }
+
+		uint32_t u32() { uint32_t V = 0; read(&V, sizeof(V)); return V; }
+		uint64_t u64() { uint64_t V = 0; read(&V, sizeof(V)); return V; }
+		llvm::StringRef str() {
+			uint32_t N = u32();
+			if (Failed || (size_t)(End - P) < N) {
+				Failed = true;
+				return llvm::StringRef();
+			}
+			llvm::StringRef S(P, N);
+			P += N;
+			return S;
+		}
+		// Read a count of elements of at least MinSize bytes each
+		uint32_t count(size_t MinSize) {
+			uint32_t N = u32();
+			if ((size_t)(End - P) / MinSize < N)
+				Failed = true;
+			return Failed ? 0 : N;
+		}
+		// Skip a map of <u64, #elements, elements of ElemSize bytes>
+		void skipMap(size_t ElemSize) {
+			uint32_t N = count(12);
+			for (uint32_t i = 0; i < N && !Failed; ++i) {
+				u64();
+				uint32_t M = count(ElemSize);
+				skip(M * ElemSize);
+			}
+		}
+		void skip(size_t N) {
+			if (Failed || (size_t)(End - P) < N)
+				Failed = true;
+			else
+				P += N;
+		}
+
+		void fail() { Failed = true; }
+		bool failed() const { return Failed; }
+		bool atEnd() const { return P == End; }
+
+	private:
+		const char *P, *End;
+		bool Failed;
+
+		void read(void *V, size_t N) {
+			if (Failed || (size_t)(End - P) < N) {
+				Failed = true;
+				return;
+			}
+			memcpy(V, P, N);
+			P += N;
+		}
+};
+
+#endif
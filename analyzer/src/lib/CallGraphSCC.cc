@@ -0,0 +1,187 @@
+//===-- CallGraphSCC.cc - SCCs of the call-graph----------------===//
+//
+// This file condenses a call relation into strongly connected
+// components with an iterative version of Tarjan's algorithm, and
+// schedules bottom-up visits of the components on a thread pool.
+//
+//===-----------------------------------------------------------===//
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+
+#include "CallGraphSCC.h"
+
+void CallGraphSCC::build(ArrayRef<Function *> Roots,
+		CalleesFn GetCallees) {
+
+	const uint32_t Unvisited = ~0U;
+
+	// Nodes are numbered when first seen; the callees of a node are
+	// NodeCallees[CalleeBegins[i], CalleeEnds[i])
+	DenseMap<Function *, uint32_t> NodeIDs;
+	vector<Function *> Nodes;
+	vector<uint32_t> Index, Low, CalleeBegins, CalleeEnds;
+	vector<uint32_t> NodeCallees;
+	vector<bool> OnStack;
+
+	auto getNode = [&](Function *F) {
+		auto Ins = NodeIDs.insert(make_pair(F, (uint32_t)Nodes.size()));
+		if (Ins.second) {
+			Nodes.push_back(F);
+			Index.push_back(Unvisited);
+			Low.push_back(0);
+			CalleeBegins.push_back(0);
+			CalleeEnds.push_back(0);
+			OnStack.push_back(false);
+		}
+		return Ins.first->second;
+	};
+
+	SCCOffsets.assign(1, 0);
+	SCCFuncs.clear();
+	FuncSCCs.clear();
+	vector<uint32_t> NodeSCCs;
+
+	uint32_t Counter = 0;
+	vector<uint32_t> Stack;
+	// <node, position of the next callee to visit>
+	vector<pair<uint32_t, uint32_t>> Frames;
+	SmallVector<Function *, 16> Callees;
+
+	auto visit = [&](uint32_t V) {
+		Index[V] = Low[V] = Counter++;
+		Stack.push_back(V);
+		OnStack[V] = true;
+
+		Callees.clear();
+		GetCallees(Nodes[V], Callees);
+		CalleeBegins[V] = NodeCallees.size();
+		for (Function *CF : Callees) {
+			uint32_t W = getNode(CF);
+			NodeCallees.push_back(W);
+		}
+		CalleeEnds[V] = NodeCallees.size();
+		Frames.push_back(make_pair(V, CalleeBegins[V]));
+	};
+
+	for (Function *Root : Roots) {
+		uint32_t R = getNode(Root);
+		if (Index[R] != Unvisited)
+			continue;
+		visit(R);
+
+		while (!Frames.empty()) {
+			uint32_t V = Frames.back().first;
+			uint32_t &Pos = Frames.back().second;
+			if (Pos < CalleeEnds[V]) {
+				uint32_t W = NodeCallees[Pos++];
+				if (Index[W] == Unvisited)
+					visit(W);
+				else if (OnStack[W])
+					Low[V] = min(Low[V], Index[W]);
+				continue;
+			}
+
+			Frames.pop_back();
+			if (!Frames.empty()) {
+				uint32_t U = Frames.back().first;
+				Low[U] = min(Low[U], Low[V]);
+			}
+			if (Low[V] != Index[V])
+				continue;
+
+			// V is the root of an SCC
+			uint32_t S = size();
+			uint32_t W;
+			do {
+				W = Stack.back();
+				Stack.pop_back();
+				OnStack[W] = false;
+				SCCFuncs.push_back(Nodes[W]);
+				FuncSCCs[Nodes[W]] = S;
+			} while (W != V);
+			SCCOffsets.push_back(SCCFuncs.size());
+		}
+	}
+
+	// Condense the callee relation
+	SCCSuccOffsets.assign(1, 0);
+	SCCSuccCol.clear();
+	vector<uint32_t> Succs;
+	for (uint32_t S = 0; S < size(); ++S) {
+		Succs.clear();
+		for (Function *F : getSCC(S)) {
+			uint32_t V = NodeIDs[F];
+			for (uint32_t i = CalleeBegins[V]; i < CalleeEnds[V]; ++i) {
+				uint32_t T = FuncSCCs[Nodes[NodeCallees[i]]];
+				if (T != S)
+					Succs.push_back(T);
+			}
+		}
+		std::sort(Succs.begin(), Succs.end());
+		Succs.erase(std::unique(Succs.begin(), Succs.end()), Succs.end());
+		SCCSuccCol.insert(SCCSuccCol.end(), Succs.begin(), Succs.end());
+		SCCSuccOffsets.push_back(SCCSuccCol.size());
+	}
+}
+
+void CallGraphSCC::runBottomUp(unsigned NumThreads,
+		function<void(uint32_t)> Fn) const {
+
+	size_t N = size();
+	if (NumThreads <= 1 || N <= 1) {
+		// IDs are in reverse topological order already
+		for (uint32_t S = 0; S < N; ++S)
+			Fn(S);
+		return;
+	}
+
+	// Callers of each SCC, and the number of unfinished callees
+	vector<vector<uint32_t>> Preds(N);
+	vector<uint32_t> Pending(N);
+	for (uint32_t S = 0; S < N; ++S) {
+		ArrayRef<uint32_t> Succs = getCalleeSCCs(S);
+		Pending[S] = Succs.size();
+		for (uint32_t T : Succs)
+			Preds[T].push_back(S);
+	}
+
+	mutex Lock;
+	condition_variable Ready;
+	deque<uint32_t> ReadyList;
+	size_t Finished = 0;
+	for (uint32_t S = 0; S < N; ++S)
+		if (Pending[S] == 0)
+			ReadyList.push_back(S);
+
+	auto worker = [&]() {
+		unique_lock<mutex> Guard(Lock);
+		while (true) {
+			Ready.wait(Guard, [&]() {
+				return !ReadyList.empty() || Finished == N;
+			});
+			if (ReadyList.empty())
+				return;
+			uint32_t S = ReadyList.front();
+			ReadyList.pop_front();
+
+			Guard.unlock();
+			Fn(S);
+			Guard.lock();
+
+			++Finished;
+			for (uint32_t P : Preds[S])
+				if (--Pending[P] == 0)
+					ReadyList.push_back(P);
+			Ready.notify_all();
+		}
+	};
+
+	vector<thread> Threads;
+	for (unsigned t = 0; t < NumThreads; ++t)
+		Threads.push_back(thread(worker));
+	for (auto &T : Threads)
+		T.join();
+}
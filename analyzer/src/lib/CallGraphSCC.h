@@ -0,0 +1,67 @@
+#ifndef CALL_GRAPH_SCC_H
+#define CALL_GRAPH_SCC_H
+
+#include <llvm/IR/Function.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <functional>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+//
+// Strongly connected components of a call relation, found with
+// Tarjan's algorithm, and a scheduler that visits them bottom-up.
+// SCC IDs are in reverse topological order: the callee SCCs of an
+// SCC always have smaller IDs.
+//
+class CallGraphSCC {
+
+	public:
+		// Get the callees of a function in the relation
+		typedef function<void(Function *, SmallVectorImpl<Function *> &)>
+			CalleesFn;
+
+		// Find the SCCs of the functions reachable from Roots
+		void build(ArrayRef<Function *> Roots, CalleesFn GetCallees);
+
+		size_t size() const { return SCCOffsets.size() - 1; }
+
+		ArrayRef<Function *> getSCC(uint32_t S) const {
+			return makeArrayRef(SCCFuncs.data() + SCCOffsets[S],
+					SCCOffsets[S + 1] - SCCOffsets[S]);
+		}
+
+		// SCCs called by the SCC, without itself
+		ArrayRef<uint32_t> getCalleeSCCs(uint32_t S) const {
+			return makeArrayRef(SCCSuccCol.data() + SCCSuccOffsets[S],
+					SCCSuccOffsets[S + 1] - SCCSuccOffsets[S]);
+		}
+
+		// SCC of the function; ~0U if it is not reachable from Roots
+		uint32_t getSCCID(Function *F) const {
+			auto it = FuncSCCs.find(F);
+			return it == FuncSCCs.end() ? ~0U : it->second;
+		}
+
+		// Call Fn on every SCC after it has been called on all its
+		// callee SCCs. Independent SCCs are processed in parallel with
+		// NumThreads threads.
+		void runBottomUp(unsigned NumThreads,
+				function<void(uint32_t)> Fn) const;
+
+	private:
+		// Functions of SCC i are SCCFuncs[SCCOffsets[i],
+		// SCCOffsets[i + 1])
+		vector<uint32_t> SCCOffsets;
+		vector<Function *> SCCFuncs;
+		DenseMap<Function *, uint32_t> FuncSCCs;
+
+		// The condensed graph
+		vector<uint32_t> SCCSuccOffsets;
+		vector<uint32_t> SCCSuccCol;
+};
+
+#endif
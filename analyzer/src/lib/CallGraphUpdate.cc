@@ -0,0 +1,318 @@
+//===-- CallGraphUpdate.cc - Incremental call-graph update------===//
+//
+// This file updates a built call graph when some modules change,
+// without going through the unchanged modules again. With
+// setIncremental(), CallGraphPass keeps the type maps and function
+// records of each module; on an update, the facts of removed modules
+// are dropped, the added modules are initialized, and the global maps
+// are merged again from the kept facts in module order. The keys
+// whose function sets changed tell which call sites of unchanged
+// modules have to be resolved again; the others keep their callees.
+// The result is the same as the one of a full run, which
+// verifyCallGraph() checks.
+//
+// loadCallGraph() uses the update for a saved call graph whose
+// modules partly changed: the saved facts and call sites stand for
+// the previous run, and the changed modules are removed and added.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/ADT/DenseSet.h>
+
+#include "CallGraph.h"
+#include "Config.h"
+#include "Common.h"
+
+// Add the keys of the sets that differ between the maps to Keys
+static void diffFuncIDMaps(DenseMap<size_t, FuncIDSet> &Old,
+		DenseMap<size_t, FuncIDSet> &New, DenseSet<size_t> &Keys) {
+
+	for (auto &E : Old) {
+		auto it = New.find(E.first);
+		if (it == New.end() ? !E.second.empty() : !(it->second == E.second))
+			Keys.insert(E.first);
+	}
+	for (auto &E : New) {
+		if (!E.second.empty() && Old.find(E.first) == Old.end())
+			Keys.insert(E.first);
+	}
+}
+
+template <typename MapTy, typename SetTy>
+static void diffFuncMaps(MapTy &Old, MapTy &New, SetTy &Keys) {
+
+	for (auto &E : Old) {
+		auto it = New.find(E.first);
+		if (it == New.end() || it->second != E.second)
+			Keys.insert(E.first);
+	}
+	for (auto &E : New) {
+		if (Old.find(E.first) == Old.end())
+			Keys.insert(E.first);
+	}
+}
+
+void CallGraphPass::updateModules(ModuleList &modules,
+		const vector<Module *> &Removed, const vector<Module *> &Added) {
+
+	updateModules(modules, Removed, Added, DenseSet<CallInst *>());
+}
+
+// StaleCalls are call sites of unchanged modules that have to be
+// resolved again anyway, as their callees are no longer known
+void CallGraphPass::updateModules(ModuleList &modules,
+		const vector<Module *> &Removed, const vector<Module *> &Added,
+		const DenseSet<CallInst *> &StaleCalls) {
+
+	assert(KeepModuleFacts && "Module facts are not kept");
+
+	OP << "[" << ID << "] Updating the call graph: " << Removed.size()
+		<< " modules removed, " << Added.size() << " added\n";
+
+	SmallPtrSet<Module *, 8> Changed;
+	for (Module *M : Removed) {
+		ModuleFactsMap.erase(M);
+		Changed.insert(M);
+	}
+
+	vector<unique_ptr<ModuleFacts>> Facts(Added.size());
+	parallelFor(Added.size(), getNumThreads(), [&](size_t i, unsigned t) {
+		Facts[i] = initModuleFacts(Added[i]);
+	});
+	for (size_t i = 0; i < Added.size(); ++i) {
+		ModuleFactsMap[Added[i]] = std::move(Facts[i]);
+		Changed.insert(Added[i]);
+	}
+
+	//
+	// Merge the global maps again, keeping the old ones to find the
+	// changed keys
+	//
+	NameFuncMap OldGlobalFuncs;
+	DenseMap<size_t, Function *> OldUnifiedFuncMap;
+	set<size_t> OldEscapeSet;
+	OldGlobalFuncs.swap(Ctx->GlobalFuncs);
+	OldUnifiedFuncMap.swap(Ctx->UnifiedFuncMap);
+	OldEscapeSet.swap(typeEscapeSet);
+	Ctx->AddressTakenFuncs.clear();
+	Ctx->sigFuncsMap.clear();
+	Ctx->UnifiedFuncSet.clear();
+	typeFuncsMap.clear();
+	typeConfineMap.clear();
+	typeTransitMap.clear();
+	typeFieldsMap.clear();
+
+	for (auto &MP : modules) {
+		auto it = ModuleFactsMap.find(MP.first);
+		assert(it != ModuleFactsMap.end() && "Module was not initialized");
+		addModuleFacts(*it->second);
+	}
+	if (!modules.empty())
+		setModuleLayout(modules.back().first);
+
+	// Names and function hashes that map to other functions
+	unordered_set<string> ChangedNames;
+	DenseSet<size_t> ChangedHashes;
+	diffFuncMaps(OldGlobalFuncs, Ctx->GlobalFuncs, ChangedNames);
+	diffFuncMaps(OldUnifiedFuncMap, Ctx->UnifiedFuncMap, ChangedHashes);
+
+	// Signatures and <type, field> keys with other targets
+	DenseSet<size_t> ChangedSigs, ChangedTypes;
+#ifdef MLTA_FOR_INDIRECT_CALL
+	DenseMap<size_t, FuncIDSet> OldSigFuncIDsMap, OldTypeFuncIDsMap;
+	OldSigFuncIDsMap.swap(sigFuncIDsMap);
+	OldTypeFuncIDsMap.swap(typeFuncIDsMap);
+	buildFuncIDSets();
+	diffFuncIDMaps(OldSigFuncIDsMap, sigFuncIDsMap, ChangedSigs);
+	diffFuncIDMaps(OldTypeFuncIDsMap, typeFuncIDsMap, ChangedTypes);
+	for (size_t H : OldEscapeSet) {
+		if (!typeEscapeSet.count(H))
+			ChangedTypes.insert(H);
+	}
+	for (size_t H : typeEscapeSet) {
+		if (!OldEscapeSet.count(H))
+			ChangedTypes.insert(H);
+	}
+	MLTACalleesMap.clear();
+#elif SOUND_MODE
+	sigBucketMap.clear();
+	varArgFuncs.clear();
+	typeCalleesMap.clear();
+	buildSigBuckets();
+#endif
+
+	// Function hashes are only computed once per callee
+	DenseMap<Function *, size_t> FuncHashes;
+	auto getFuncHash = [&](Function *F) {
+		auto it = FuncHashes.find(F);
+		if (it != FuncHashes.end())
+			return it->second;
+		size_t fh = funcHash(F);
+		FuncHashes[F] = fh;
+		return fh;
+	};
+
+	// Whether the callees of a call site of an unchanged module may
+	// have changed
+	CallGraphCSR OldCG(std::move(Ctx->CallGraph));
+	auto isAffected = [&](CallInst *CI, bool IsIndirect) {
+		if (StaleCalls.count(CI))
+			return true;
+		if (IsIndirect) {
+#ifdef MLTA_FOR_INDIRECT_CALL
+			size_t CH = callHash(CI);
+			if (ChangedSigs.count(CH))
+				return true;
+			if (!sigFuncIDsMap.count(CH))
+				return false;
+			SmallVector<pair<size_t, int>, 4> Layers;
+			collectLayers(CI, CH, Layers);
+			for (auto &L : Layers) {
+				if (ChangedTypes.count(L.first) ||
+						ChangedTypes.count(hashIdxHash(L.first, L.second)))
+					return true;
+			}
+			return false;
+#else
+			return true;
+#endif
+		}
+
+		Function *CF = CI->getCalledFunction();
+		if (!CF)
+			return false;
+		if (CF->empty()) {
+			string FName = CF->getName().str();
+			if (StringRef(FName).startswith("SyS_"))
+				FName = "sys_" + FName.substr(4);
+			if (ChangedNames.count(FName))
+				return true;
+			auto git = Ctx->GlobalFuncs.find(FName);
+			if (git != Ctx->GlobalFuncs.end() && git->second)
+				CF = git->second;
+		}
+		return ChangedHashes.count(getFuncHash(CF)) != 0;
+	};
+
+	// Call sites of unchanged modules by module, in ID order
+	DenseMap<Module *, vector<uint32_t>> ModuleCallIDs;
+	for (uint32_t i = 0; i < OldCG.getNumCallSites(); ++i) {
+		Module *M = OldCG.getCallSite(i)->getModule();
+		if (!Changed.count(M))
+			ModuleCallIDs[M].push_back(i);
+	}
+
+	//
+	// Add the call sites again in module order
+	//
+	Ctx->CallGraph = CallGraphCSR(Ctx);
+	Ctx->IndirectCallInsts.clear();
+	size_t NumResolved = 0, NumKept = 0;
+	for (auto &MP : modules) {
+		Module *M = MP.first;
+		if (Changed.count(M)) {
+			ModuleCalls MC;
+			collectModuleCalls(M, MC);
+			addModuleCalls(MC);
+			NumResolved += MC.Callees.size();
+			continue;
+		}
+
+		CurrentLayout = &(M->getDataLayout());
+		for (uint32_t i : ModuleCallIDs[M]) {
+			CallInst *CI = OldCG.getCallSite(i);
+			bool IsIndirect = i >= OldCG.getNumDirectCalls();
+			if (isAffected(CI, IsIndirect)) {
+				FuncSet FS;
+				findCallees(CI, FS);
+				Ctx->CallGraph.addCallSite(CI, FS, IsIndirect);
+				++NumResolved;
+			}
+			else {
+				Ctx->CallGraph.addCallSite(CI,
+						OldCG.getCalleeSet(OldCG.getCallSetID(i)),
+						OldCG.getResolvedCalleeOf(i), IsIndirect);
+				++NumKept;
+			}
+			if (IsIndirect)
+				Ctx->IndirectCallInsts.push_back(CI);
+		}
+	}
+	if (!modules.empty())
+		CurrentLayout = &(modules.back().first->getDataLayout());
+
+	Ctx->CallGraph.finalize();
+	OP << "[" << ID << "] " << NumResolved << " call sites resolved, "
+		<< NumKept << " kept; " << Ctx->CallGraph.getNumCallSites()
+		<< " call sites, " << Ctx->CallGraph.getNumCalleeSets()
+		<< " distinct callee sets, " << Ctx->CallGraph.getNumEdges()
+		<< " call edges\n";
+}
+
+// Clear the lookup structures and caches shared by the pass
+// instances, so that a new pass builds them again
+void CallGraphPass::clearCaches() {
+
+	sigFuncIDsMap.clear();
+	typeFuncIDsMap.clear();
+	FuncIDSetsBuilt = false;
+	MLTACalleesMap.clear();
+	sigBucketMap.clear();
+	varArgFuncs.clear();
+	typeCalleesMap.clear();
+}
+
+bool CallGraphPass::verifyCallGraph(ModuleList &modules) {
+
+	// Callees of the call sites, ordered by function ID
+	CallGraphCSR &CG = Ctx->CallGraph;
+	DenseMap<CallInst *, uint32_t> OldCallIDs;
+	vector<vector<Function *>> OldCallees(CG.getNumCallSites());
+	vector<Function *> OldResolved(CG.getNumCallSites());
+	for (uint32_t i = 0; i < CG.getNumCallSites(); ++i) {
+		OldCallIDs[CG.getCallSite(i)] = i;
+		OldCallees[i] = CG.getCalleeSet(CG.getCallSetID(i)).vec();
+		OldResolved[i] = CG.getResolvedCalleeOf(i);
+	}
+
+	OP << "[" << ID << "] Verifying the call graph with a full rebuild\n";
+	Ctx->CallGraph = CallGraphCSR(Ctx);
+	Ctx->IndirectCallInsts.clear();
+	Ctx->AddressTakenFuncs.clear();
+	Ctx->sigFuncsMap.clear();
+	Ctx->GlobalFuncs.clear();
+	Ctx->UnifiedFuncMap.clear();
+	Ctx->UnifiedFuncSet.clear();
+	clearCaches();
+	CallGraphPass Full(Ctx);
+	Full.run(modules);
+
+	// The resolved callee of an indirect call is the first one found
+	// in a pointer set, which depends on the run; it is only compared
+	// for direct calls
+	size_t Mismatches = 0;
+	for (uint32_t i = 0; i < CG.getNumCallSites(); ++i) {
+		CallInst *CI = CG.getCallSite(i);
+		auto it = OldCallIDs.find(CI);
+		bool Same = (it != OldCallIDs.end());
+		if (Same) {
+			Same = (CG.getCalleeSet(CG.getCallSetID(i)) ==
+					makeArrayRef(OldCallees[it->second]));
+			if (Same && i < CG.getNumDirectCalls())
+				Same = (CG.getResolvedCalleeOf(i) == OldResolved[it->second]);
+			OldCallIDs.erase(it);
+		}
+		if (!Same) {
+			++Mismatches;
+			OP << "[" << ID << "] Mismatch at " << *CI << " in "
+				<< CI->getFunction()->getName() << "\n";
+		}
+	}
+	// Call sites that are not in the full build
+	Mismatches += OldCallIDs.size();
+
+	OP << "[" << ID << "] Verified the call graph: "
+		<< CG.getNumCallSites() << " call sites, "
+		<< Mismatches << " mismatches\n";
+	return Mismatches == 0;
+}
@@ -1,11 +1,12 @@
 #include <llvm/IR/InlineAsm.h>
 #include <llvm/IR/InstIterator.h>
+#include <llvm/Analysis/ValueTracking.h>
 #include <fstream>
 #include <regex>
+#include <thread>
+#include <atomic>
 #include "Common.h"
-
-// To print source code information, configure the path
-#define LINUX_SOURCE "/your-path-of-the-linux-source/linux-5.3.0"
+#include "SourceCache.h"
 
 bool trimPathSlash(string &path, int slash) {
 	while (slash > 0) {
@@ -28,7 +29,8 @@ string getFileName(DILocation *Loc, DISubprogram *SP) {
 	// TODO: require config
 	int slashToTrim = 2;
 	trimPathSlash(FN, slashToTrim);
-	FN = string(LINUX_SOURCE) + "/" + FN;
+	if (!SourceRoot.empty())
+		FN = SourceRoot + "/" + FN;
 	return FN;
 }
 
@@ -47,17 +49,8 @@ bool isConstant(Value *V) {
 }
 
 /// Get the source code line
-string getSourceLine(string fn_str, unsigned lineno) {
-	std::ifstream sourcefile(fn_str);
-	string line;
-	sourcefile.seekg(ios::beg);
-	
-	for(int n = 0; n < lineno - 1; ++n){
-		sourcefile.ignore(std::numeric_limits<streamsize>::max(), '\n');
-	}
-	getline(sourcefile, line);
-
-	return line;
+StringRef getSourceLine(string fn_str, unsigned lineno) {
+	return getSourceCache().getLine(fn_str, lineno);
 }
 
 string getSourceFuncName(Instruction *I) {
@@ -67,12 +60,26 @@ string getSourceFuncName(Instruction *I) {
 		return "";
 	unsigned lineno = Loc->getLine();
 	std::string fn_str = getFileName(Loc);
-	string line = getSourceLine(fn_str, lineno);
-	
-	while(line[0] == ' ' || line[0] == '\t')
-		line.erase(line.begin());
-	line = line.substr(0, line.find('('));
-	return line;
+	StringRef line = getSourceLine(fn_str, lineno).ltrim(" \t");
+	return line.substr(0, line.find('(')).str();
+}
+
+/// Get the log level of a *printk call from the KERN_<LEVEL> prefix
+/// of its format string, i.e., the first constant string argument:
+/// 0 (KERN_EMERG) to 7 (KERN_DEBUG), or -1 without a level
+int getPrintkLevel(CallInst *CI) {
+
+	for (Value *Arg : CI->arg_operands()) {
+		StringRef Fmt;
+		if (!getConstantStringInfo(Arg, Fmt))
+			continue;
+		// KERN_SOH ("\001") followed by the level
+		if (Fmt.size() >= 2 && Fmt[0] == '\001' &&
+				Fmt[1] >= '0' && Fmt[1] <= '7')
+			return Fmt[1] - '0';
+		return -1;
+	}
+	return -1;
 }
 
 string extractMacro(string line, Instruction *I) {
@@ -174,13 +181,11 @@ void printSourceCodeInfo(Value *V) {
 
 	unsigned LineNo = Loc->getLine();
 	std::string FN = getFileName(Loc);
-	string line = getSourceLine(FN, LineNo);
+	StringRef line = getSourceLine(FN, LineNo).ltrim(" \t");
 	FN = Loc->getFilename().str();
 	FN = FN.substr(FN.find('/') + 1);
 	FN = FN.substr(FN.find('/') + 1);
 
-	while(line[0] == ' ' || line[0] == '\t')
-		line.erase(line.begin());
 	OP << " ["
 		<< "\033[34m" << "Code" << "\033[0m" << "] "
 		<< FN
@@ -194,9 +199,7 @@ void printSourceCodeInfo(Function *F) {
 
 	if (SP) {
 		string FN = getFileName(NULL, SP);
-		string line = getSourceLine(FN, SP->getLine());
-		while(line[0] == ' ' || line[0] == '\t')
-			line.erase(line.begin());
+		StringRef line = getSourceLine(FN, SP->getLine()).ltrim(" \t");
 
 		FN = SP->getFilename().str();
 		FN = FN.substr(FN.find('/') + 1);
@@ -220,16 +223,13 @@ string getMacroInfo(Value *V) {
 
 	unsigned LineNo = Loc->getLine();
 	std::string FN = getFileName(Loc);
-	string line = getSourceLine(FN, LineNo);
+	string line = getSourceLine(FN, LineNo).ltrim(" \t").str();
 	FN = Loc->getFilename().str();
 	const char *filename = FN.c_str();
 	filename = strchr(filename, '/') + 1;
 	filename = strchr(filename, '/') + 1;
 	int idx = filename - FN.c_str();
 
-	while(line[0] == ' ' || line[0] == '\t')
-		line.erase(line.begin());
-
 	string macro = extractMacro(line, I);
 
 	//clean up the ending and whitespaces
@@ -282,6 +282,35 @@ Argument *getArgByNo(Function *F, int8_t ArgNo) {
   return ai;
 }
 
+unsigned getNumThreads() {
+
+	unsigned NumThreads = NumThreadsOpt;
+	if (NumThreads == 0)
+		NumThreads = thread::hardware_concurrency();
+	return NumThreads ? NumThreads : 1;
+}
+
+void parallelFor(size_t N, unsigned NumThreads,
+		function<void(size_t, unsigned)> Fn) {
+
+	if (NumThreads <= 1 || N <= 1) {
+		for (size_t i = 0; i < N; ++i)
+			Fn(i, 0);
+		return;
+	}
+
+	atomic<size_t> Next(0);
+	vector<thread> Threads;
+	for (unsigned t = 0; t < NumThreads; ++t) {
+		Threads.push_back(thread([&, t]() {
+			for (size_t i = Next++; i < N; i = Next++)
+				Fn(i, t);
+		}));
+	}
+	for (auto &T : Threads)
+		T.join();
+}
+
 //#define HASH_SOURCE_INFO
 size_t funcHash(Function *F, bool withName) {
 
@@ -407,13 +436,7 @@ void getSourceCodeLine(Value *V, string &line) {
 
 	unsigned LineNo = Loc->getLine();
 	std::string FN = getFileName(Loc);
-	line = getSourceLine(FN, LineNo);
-	FN = Loc->getFilename().str();
-	FN = FN.substr(FN.find('/') + 1);
-	FN = FN.substr(FN.find('/') + 1);
-
-	while(line[0] == ' ' || line[0] == '\t')
-		line.erase(line.begin());
+	line = getSourceLine(FN, LineNo).ltrim(" \t").str();
 
 	return;
 }
@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <bitset>
 #include <chrono>
+#include <functional>
 
 using namespace llvm;
 using namespace std;
@@ -43,8 +44,10 @@ using namespace std;
 #define KWHT  "\x1B[37m"  /* White */
 
 extern cl::opt<unsigned> VerboseLevel;
+extern cl::opt<unsigned> NumThreadsOpt;
+extern cl::opt<string> SourceRoot;
 extern map<Type*, string> TypeToTNameMap;
-extern const DataLayout *CurrentLayout;
+extern thread_local const DataLayout *CurrentLayout;
 
 //
 // Common functions
@@ -55,10 +58,13 @@ string getFileName(DILocation *Loc,
 
 bool isConstant(Value *V);
 
-string getSourceLine(string fn_str, unsigned lineno);
+// The line of the source file, from the shared source cache
+StringRef getSourceLine(string fn_str, unsigned lineno);
 
 string getSourceFuncName(Instruction *I);
 
+int getPrintkLevel(CallInst *CI);
+
 StringRef getCalledFuncName(Instruction *I);
 
 string extractMacro(string, Instruction* I);
@@ -74,6 +80,13 @@ void getSourceCodeInfo(Value *V, string &file,
 
 Argument *getArgByNo(Function *F, int8_t ArgNo);
 
+// Number of threads for parallel analyses (0: one per core)
+unsigned getNumThreads();
+// Call Fn(Idx, ThreadNo) for each Idx in [0, N) with NumThreads
+// threads. Indices are handed out in increasing order.
+void parallelFor(size_t N, unsigned NumThreads,
+		function<void(size_t, unsigned)> Fn);
+
 size_t funcHash(Function *F, bool withName = true);
 size_t callHash(CallInst *CI);
 size_t typeHash(Type *Ty);
@@ -92,11 +105,16 @@ class ModuleOracle {
 public:
   ModuleOracle(Module &m) :
     dl(m.getDataLayout()),
-    tli(TargetLibraryInfoImpl(Triple(Twine(m.getTargetTriple()))))
+    tlii(Triple(Twine(m.getTargetTriple()))),
+    tli(tlii)
   {}
 
   ~ModuleOracle() {}
 
+  // tli refers to tlii
+  ModuleOracle(const ModuleOracle &) = delete;
+  ModuleOracle &operator=(const ModuleOracle &) = delete;
+
   // Getter
   const DataLayout &getDataLayout() {
     return dl;
@@ -142,6 +160,7 @@ public:
 protected:
   // Info provide
   const DataLayout &dl;
+  TargetLibraryInfoImpl tlii;
   TargetLibraryInfo tli;
 
   // Consts
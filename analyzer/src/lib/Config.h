@@ -8,6 +8,8 @@
 #include <set>
 #include <unordered_set>
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 //
 // Configurations for compilation.
@@ -21,22 +23,40 @@
 // Function modeling
 //
 
-// Setup functions that handle errors
-static void SetErrorHandleFuncs(set<string> &ErrorHandleFuncs) {
+// Get the path of a file in the configs directory, which is
+// installed next to the executable
+static string getConfigPath(string Name) {
 
 	string exepath = sys::fs::getMainExecutable(NULL, NULL);
 	string exedir = exepath.substr(0, exepath.find_last_of('/'));
+	return exedir + "/configs/" + Name;
+}
+
+// Read a config file line by line, skipping empty lines and
+// comments starting with "//"
+static void readConfigLines(string Name, vector<string> &Lines) {
+
 	string line;
-  ifstream errfile(exedir	+ "/configs/err-funcs");
-  if (errfile.is_open()) {
-		while (!errfile.eof()) {
-			getline (errfile, line);
-			if (line.length() > 1) {
-				ErrorHandleFuncs.insert(line);
-			}
-		}
-    errfile.close();
-  }
+	ifstream cfgfile(getConfigPath(Name));
+	if (!cfgfile.is_open()) {
+		OP << "[Config] Cannot open configs/" << Name << "\n";
+		return;
+	}
+	while (getline(cfgfile, line)) {
+		if (line.length() <= 1 || line.compare(0, 2, "//") == 0)
+			continue;
+		Lines.push_back(line);
+	}
+	cfgfile.close();
+}
+
+// Setup functions that handle errors
+static void SetErrorHandleFuncs(set<string> &ErrorHandleFuncs) {
+
+	vector<string> Lines;
+	readConfigLines("err-funcs", Lines);
+	for (auto line : Lines)
+		ErrorHandleFuncs.insert(line);
 
 	string ErrorHandleFN[] = {
 		"BUG",
@@ -61,67 +81,57 @@ static void SetErrorHandleFuncs(set<string> &ErrorHandleFuncs) {
 	}
 }
 
+// Setup functions that should be skipped when counting unchecked
+// sources and uses. Names are quoted and separated by commas.
+static void SetSkipFuncs(set<string> &SkipFuncs) {
+
+	vector<string> Lines;
+	readConfigLines("skip-funcs", Lines);
+	for (auto line : Lines) {
+		size_t b = line.find('"');
+		while (b != string::npos) {
+			size_t e = line.find('"', b + 1);
+			if (e == string::npos)
+				break;
+			if (e > b + 1)
+				SkipFuncs.insert(line.substr(b + 1, e - b - 1));
+			b = line.find('"', e + 1);
+		}
+	}
+}
+
 // Setup functions that copy/move/cast values.
+// <name, <src_arg#, dst_arg#, size_arg#>>
 static void SetCopyFuncs(
-		// <src, dst, size>
 		map<string, tuple<int8_t, int8_t, int8_t>> &CopyFuncs) {
 
-	CopyFuncs["memcpy"] = make_tuple(1, 0, 2);
-	CopyFuncs["__memcpy"] = make_tuple(1, 0, 2);
-	CopyFuncs["llvm.memcpy.p0i8.p0i8.i32"] = make_tuple(1, 0, 2);
-	CopyFuncs["llvm.memcpy.p0i8.p0i8.i64"] = make_tuple(1, 0, 2);
-	CopyFuncs["strncpy"] = make_tuple(1, 0, 2);
-	CopyFuncs["memmove"] = make_tuple(1, 0, 2);
-	CopyFuncs["__memmove"] = make_tuple(1, 0, 2);
-	CopyFuncs["llvm.memmove.p0i8.p0i8.i32"] = make_tuple(1, 0, 2);
-	CopyFuncs["llvm.memmove.p0i8.p0i8.i64"] = make_tuple(1, 0, 2);
+	vector<string> Lines;
+	readConfigLines("copy-funcs", Lines);
+	for (auto line : Lines) {
+		string FName;
+		int Src, Dst, Size;
+		istringstream iss(line);
+		if (!(iss >> FName >> Src >> Dst >> Size))
+			continue;
+		CopyFuncs[FName] = make_tuple(Src, Dst, Size);
+	}
 }
 
 // Setup functions that fetch data from the external.
 // <name, <dst_arg#, source_arg#>>
 static void SetDataFetchFuncs(
-
 		map<string, pair<int8_t, int8_t>> &DataFetchFuncs) {
 
-	DataFetchFuncs["copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["raw_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["strncpy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["_strncpy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__strncpy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__copy_from_user_inatomic"] = make_pair(0, 1);
-	DataFetchFuncs["strndup_user"] = make_pair(-1, 0);
-	DataFetchFuncs["memdup_user"] = make_pair(-1, 0);
-	DataFetchFuncs["vmemdup_user"] = make_pair(-1, 0);
-	DataFetchFuncs["memdup_user_nul"] = make_pair(-1, 0);
-	DataFetchFuncs["get_user"] = make_pair(0, 1);
-	DataFetchFuncs["__get_user"] = make_pair(0, 1);
-	DataFetchFuncs["copyin"] = make_pair(1, 0);
-	DataFetchFuncs["copyin_str"] = make_pair(1, 0);
-	DataFetchFuncs["copyin_nofault"] = make_pair(1, 0);
-	DataFetchFuncs["fubyte"] = make_pair(-1, 0);
-	DataFetchFuncs["fusword"] = make_pair(-1, 0);
-	DataFetchFuncs["fuswintr"] = make_pair(-1, 0);
-	DataFetchFuncs["fuword"] = make_pair(-1, 0);
-
-	// more variants
-	DataFetchFuncs["rds_message_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["ivtv_buf_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["snd_trident_synth_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["copy_from_user_toio"] = make_pair(0, 1);
-	DataFetchFuncs["iov_iter_copy_from_user_atomic"] = make_pair(0, 1);
-	DataFetchFuncs["__generic_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__constant_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["copy_from_user_page"] = make_pair(0, 1);
-	DataFetchFuncs["__copy_from_user_eva"] = make_pair(0, 1);
-	DataFetchFuncs["__arch_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__copy_from_user_flushcache"] = make_pair(0, 1);
-	DataFetchFuncs["arm_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__asm_copy_from_user"] = make_pair(0, 1);
-	DataFetchFuncs["__copy_from_user_inatomic_nocache"] = make_pair(0, 1);
-	DataFetchFuncs["copy_from_user_nmi"] = make_pair(0, 1);
-	DataFetchFuncs["copy_from_user_proc"] = make_pair(0, 1);
+	vector<string> Lines;
+	readConfigLines("data-fetch-funcs", Lines);
+	for (auto line : Lines) {
+		string FName;
+		int Dst, Src;
+		istringstream iss(line);
+		if (!(iss >> FName >> Dst >> Src))
+			continue;
+		DataFetchFuncs[FName] = make_pair(Dst, Src);
+	}
 }
 
 
@@ -19,20 +19,29 @@ pair<Value *, int8_t> src_c(Value *V, int8_t Arg) {
 	return make_pair((Value *)V, (int8_t)Arg);
 }
 
-/// Get aliased pointers for this pointer.
-void DataFlowAnalysis::getAliasPointers(Value *Addr,
-		std::set<Value *> &aliasAddr,
-		PointerAnalysisMap &aliasPtrs) {
-
-	aliasAddr.clear();
-	aliasAddr.insert(Addr);
+/// Get aliased pointers for this pointer of F, including itself.
+/// With the global points-to analysis, these include the pointers of
+/// other functions with the same location; intra-procedural callers
+/// keep the ones of F with isLocalTo(). Otherwise, the alias classes
+/// of F are computed on the first query.
+AliasClass DataFlowAnalysis::getAliasPointers(Value *Addr,
+		Function *F) {
+
+	if (Ctx->PointsTo) {
+		uint32_t Loc = Ctx->PointsTo->getLocationID(Addr);
+		if (Loc == ~0U)
+			return AliasClass(Addr);
+		return AliasClass(Ctx->PointsTo->getPointers(Loc));
+	}
+	return Ctx->getAliasClasses(F).getClass(Addr);
+}
 
-	auto it = aliasPtrs.find(Addr);
-	if (it == aliasPtrs.end())
-		return;
+/// Whether the pointer can be used in F, i.e., it is a global or
+/// constant, or a local pointer of F
+bool DataFlowAnalysis::isLocalTo(Value *V, Function *F) {
 
-	for (auto itt : it->second)
-		aliasAddr.insert(itt);
+	Function *PF = SteensgaardPTA::getParentFunction(V);
+	return !PF || PF == F;
 }
 
 /// Collect reachable basic blocks from a security check
@@ -41,11 +50,18 @@ void DataFlowAnalysis::collectSuccReachBlocks(BasicBlock *BB,
 
 	if (reachBB.find(BB) != reachBB.end())
 		return;
-	reachBB.insert(BB);
 
-	succ_iterator si = succ_begin(BB), se = succ_end(BB);
-	for (; si != se; ++si)
-		collectSuccReachBlocks(*si, reachBB);
+	const CFGOverlay &CFG = Ctx->getCFGOverlay(BB->getParent());
+	SmallVector<BasicBlock *, 16> EB;
+	reachBB.insert(BB);
+	EB.push_back(BB);
+	while (!EB.empty()) {
+		BasicBlock *TB = EB.pop_back_val();
+		for (BasicBlock *Succ : CFG.successors(TB)) {
+			if (reachBB.insert(Succ).second)
+				EB.push_back(Succ);
+		}
+	}
 }
 
 /// Collect pred reachable basic blocks
@@ -54,11 +70,18 @@ void DataFlowAnalysis::collectPredReachBlocks(BasicBlock *BB,
 
 	if (reachBB.find(BB) != reachBB.end())
 		return;
-	reachBB.insert(BB);
 
-	pred_iterator pi = pred_begin(BB), pe = pred_end(BB);
-	for (; pi != pe; ++pi)
-		collectPredReachBlocks(*pi, reachBB);
+	const CFGOverlay &CFG = Ctx->getCFGOverlay(BB->getParent());
+	SmallVector<BasicBlock *, 16> EB;
+	reachBB.insert(BB);
+	EB.push_back(BB);
+	while (!EB.empty()) {
+		BasicBlock *TB = EB.pop_back_val();
+		for (BasicBlock *Pred : CFG.predecessors(TB)) {
+			if (reachBB.insert(Pred).second)
+				EB.push_back(Pred);
+		}
+	}
 }
 
 /// Track the sources and same-origin critical variables of the
@@ -90,13 +113,14 @@ void DataFlowAnalysis::findSourceCVAlias(
 			if (!CaV) 
 				continue;
 
-			StringRef FuncName = getCalledFuncName(CI);
+			FuncRoles *FR = Ctx->getCalleeRoles(CI);
+			if (!FR)
+				continue;
 			Value *Src = NULL;
-			auto dit = Ctx->DataFetchFuncs.find(FuncName.str());
-			if (dit != Ctx->DataFetchFuncs.end()) {
+			if (FR->Mask & FR_DataFetch) {
 				// FIXME: assume the dst is arg 0
-				if (dit->second.first == 0) {
-					Src = CI->getArgOperand(dit->second.second);
+				if (FR->FetchDst == 0) {
+					Src = CI->getArgOperand(FR->FetchSrc);
 				}
 			}
 			if (Src) {
@@ -108,8 +132,7 @@ void DataFlowAnalysis::findSourceCVAlias(
 				continue;
 			}
 
-			auto cit = Ctx->CopyFuncs.find(FuncName.str());
-			if (cit != Ctx->CopyFuncs.end()) {
+			if (FR->Mask & FR_Copy) {
 				// FIXME: assume the src is arg 1
 				Value *Src = CI->getArgOperand(1);
 				findSourceCV(Src, SourceSet, CVSet, TrackedSet);
@@ -154,7 +177,7 @@ void DataFlowAnalysis::findSourceCV(Value *V, set<Value *> &SourceSet,
 		return;
 
 		bool FoundCaller = false;
-		for (CallInst *Caller : Ctx->Callers[A->getParent()]) {
+		for (CallInst *Caller : Ctx->CallGraph.getCallers(A->getParent())) {
 			if (Caller) {
 				if (A->getArgNo() >= Caller->getNumArgOperands())
 					continue;
@@ -183,17 +206,16 @@ void DataFlowAnalysis::findSourceCV(Value *V, set<Value *> &SourceSet,
 		// TODO: track callers
 		Value *CaV = CI->getCalledValue();
 		if (CaV) {
-			StringRef FuncName = getCalledFuncName(CI);
 			Value *Src = NULL;
-			auto it = Ctx->DataFetchFuncs.find(FuncName.str());
-			if (it != Ctx->DataFetchFuncs.end()) {
+			FuncRoles *FR = Ctx->getCalleeRoles(CI);
+			if (FR && (FR->Mask & FR_DataFetch)) {
 				// Functions like memdup_user
-				if (it->second.first == -1) {
-					Src = CI->getArgOperand(it->second.second);
+				if (FR->FetchDst == -1) {
+					Src = CI->getArgOperand(FR->FetchSrc);
 				}
 			}
 			else if (dyn_cast<InlineAsm>(CaV) 
-					&& FuncName.contains("get_user")) {
+					&& getCalledFuncName(CI).contains("get_user")) {
 				Src = CI->getArgOperand(0);
 			}
 			if (Src) {
@@ -238,8 +260,7 @@ void DataFlowAnalysis::findSourceCV(Value *V, set<Value *> &SourceSet,
 		Value *LPO = LI->getPointerOperand();
 		// Get aliases
 		Function *F = LI->getParent()->getParent();
-		std::set<Value *> AliasSet;
-		getAliasPointers(LPO, AliasSet, Ctx->FuncPAResults[F]);
+		AliasClass AliasSet = getAliasPointers(LPO, F);
 
 		// To find all stores using the pointer
 		// TODO: use alias analysis
@@ -347,45 +368,37 @@ void DataFlowAnalysis::findInFuncSourceCV(Value *V, set<Value *> &SourceSet,
 		Value *LPO = LI->getPointerOperand();
 		// Get aliases
 		Function *F = LI->getParent()->getParent();
-		std::set<Value *> AliasSet;
-		getAliasPointers(LPO, AliasSet, Ctx->FuncPAResults[F]);
-
-		// To find all stores using the pointer
-		// TODO: use alias analysis
-		set<BasicBlock *> reachBBs;
-		collectPredReachBlocks(LI->getParent(), reachBBs);
-
+		AliasClass AliasSet = getAliasPointers(LPO, F);
+		SmallPtrSet<Value *, 8> Aliases;
 		for (Value *A : AliasSet) {
-			for (User *U : A->users()) {
+			if (isLocalTo(A, F))
+				Aliases.insert(A);
+		}
 
-				Instruction *I = dyn_cast<Instruction>(U);
-				if (!I)
-					continue;
-				if (reachBBs.find(I->getParent()) == reachBBs.end())
-					continue;
+		// To find all stores to the aliases that reach the load
+		SmallVector<Instruction *, 8> Defs;
+		Ctx->getMemoryDefUse(F).getReachingDefs(LI, Defs);
+		for (Instruction *I : Defs) {
 
-				StoreInst *SI = dyn_cast<StoreInst>(U);
-				if (SI && A == SI->getPointerOperand()) {
+			StoreInst *SI = dyn_cast<StoreInst>(I);
+			if (SI) {
+				if (Aliases.count(SI->getPointerOperand())) {
 					Value *SVO = SI->getValueOperand();
 					findInFuncSourceCV(SVO, SourceSet, CVSet, TrackedSet);
-					continue;
 				}
+				continue;
+			}
 
-				// Find sources from external, e.g., like copy_from_user
-				// TODO: need further investigation
-				if (CallInst *CI = dyn_cast<CallInst>(U) ) {
-					// Get ArgNo
-					int8_t ArgNo = -1; 
-					CallSite CS(CI);
-					for (CallSite::arg_iterator ai = CS.arg_begin(),
-							ae = CS.arg_end(); ai != ae; ++ai) {
-						++ArgNo;
-						if (A == *ai)
-							break;
-					}
-					SourceSet.insert(CI->getOperand(ArgNo));
-					CVSet.insert(CI->getOperand(ArgNo));
-					continue;
+			// Find sources from external, e.g., like copy_from_user
+			// TODO: need further investigation
+			if (CallInst *CI = dyn_cast<CallInst>(I)) {
+				for (unsigned j = 0, e = CI->getNumArgOperands(); j < e; ++j) {
+					Value *Arg = CI->getArgOperand(j);
+					if (!Aliases.count(Arg))
+						continue;
+					SourceSet.insert(Arg);
+					CVSet.insert(Arg);
+					break;
 				}
 			}
 		}
@@ -574,10 +587,12 @@ void DataFlowAnalysis::findUses(Instruction *BorderInsn, Value *Target,
 			}
 			// Used as the value operand
 			else {
-				set<Value *> AliasSet;
-				getAliasPointers(SI->getPointerOperand(), AliasSet, 
-						Ctx->FuncPAResults[SI->getParent()->getParent()]);
+				Function *F = SI->getFunction();
+				AliasClass AliasSet = getAliasPointers(SI->getPointerOperand(), F);
 				for (Value *A : AliasSet) {
+					// Uses in other functions are not guarded by the check
+					if (!isLocalTo(A, F))
+						continue;
 					for (User *AU : A->users()) {
 
 						Instruction *I = dyn_cast<Instruction>(AU);
@@ -661,59 +676,6 @@ void DataFlowAnalysis::findPaths(Value *Start, set<Path> &PathSet) {
 	// Use DFS to collect paths
 }
 
-bool DataFlowAnalysis::possibleUseStResult(Instruction *Inst, 
-		Instruction *St) {
-
-	BasicBlock *InstBB = Inst->getParent();
-	BasicBlock *StBB = St->getParent();
-	std::set<BasicBlock *> PB;
-	std::list<BasicBlock *> EB;
-
-	if (!InstBB || !StBB)
-		return false;
-
-	// Inst and St are in the same basic block.
-	// Iterate over each instruction see which
-	// one is seen firstly.
-	if (InstBB == StBB) {
-		for (BasicBlock::iterator I = InstBB->begin(),
-				IE = InstBB->end(); I != IE; ++I) {
-			Instruction *II = dyn_cast<Instruction>(&*I);
-			if (II == St)
-				return true;
-			if (II == Inst)
-				return false;
-		}
-		return false;
-	}
-
-	// See if there exists a path from StBB to LdBB.
-	PB.clear();
-	EB.clear();
-
-	EB.push_back(StBB);
-	while (!EB.empty()) {
-		BasicBlock *TB = EB.front();
-		Instruction *TI;
-
-		EB.pop_front();
-		if (PB.count(TB) != 0)
-			continue;
-		PB.insert(TB);
-
-		if (TB == InstBB)
-			return true;
-
-		TI = TB->getTerminator();
-		for (unsigned i = 0, e = TI->getNumSuccessors();
-				i != e; ++i) {
-			EB.push_back(TI->getSuccessor(i));
-		}
-	}
-
-	return false;
-}
-
 void DataFlowAnalysis::performBackwardAnalysis(Function* F, Value* V, 
 		set<Value *>& CISet) {
 
@@ -735,16 +697,11 @@ void DataFlowAnalysis::performBackwardAnalysis(Function* F, Value* V,
 		else
 			LPSet.insert(LI->getPointerOperand());
 
-		for (auto i = inst_begin(F), e = inst_end(F); i != e; ++i) {
-			StoreInst *SI = dyn_cast<StoreInst>(&*i);
-			if (!SI) 
-				continue;
-			if (!possibleUseStResult(LI, SI)) 
-				continue;
-			if (SI->getPointerOperand() != LI->getPointerOperand()) 
-				continue;
+		SmallVector<StoreInst *, 8> Stores;
+		Ctx->getMemoryDefUse(F).getReachingStores(LI,
+				LI->getPointerOperand(), Stores);
+		for (StoreInst *SI : Stores)
 			performBackwardAnalysis(F, SI->getValueOperand(), CISet);
-		}
 		return;
 	}
 
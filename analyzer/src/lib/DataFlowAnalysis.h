@@ -43,8 +43,6 @@ class DataFlowAnalysis {
 		void performBackwardAnalysis(Function *F, Value *V, set<Value *> &);
 		void resetStructures() { LPSet.clear(); } 
 
-		bool possibleUseStResult(Instruction *, Instruction *);
-
 		// Track the sources and same-origin critical variables of the
 		// given critical variable.
 		void findSourceCV(Value *V, set<Value *> &SourceSet, 
@@ -68,9 +66,8 @@ class DataFlowAnalysis {
 				set<BasicBlock *> &reachBB);
 
 
-		void getAliasPointers(Value *Addr,
-				std::set<Value *> &aliasAddr,
-				PointerAnalysisMap &aliasPtrs);
+		AliasClass getAliasPointers(Value *Addr, Function *F);
+		static bool isLocalTo(Value *V, Function *F);
 	private:
 		// Set of LoadPointers
 		std::set<Value *> LPSet; 
@@ -0,0 +1,119 @@
+//===-- FuncIDSet.cc - Sets of dense function IDs---------------===//
+//
+// This file implements the intersection kernels of FuncIDSet. Sets
+// of similar sizes are intersected with SSE block comparisons (when
+// available); sets of very different sizes use galloping search.
+//
+//===-----------------------------------------------------------===//
+
+#include "FuncIDSet.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Use galloping when one set is this many times larger than the other
+#define GALLOP_RATIO 32
+
+// Merge-based intersection
+static void intersectScalar(const uint32_t *A, size_t NA,
+		const uint32_t *B, size_t NB, vector<uint32_t> &Out) {
+
+	size_t i = 0, j = 0;
+	while (i < NA && j < NB) {
+		if (A[i] < B[j])
+			++i;
+		else if (B[j] < A[i])
+			++j;
+		else {
+			Out.push_back(A[i]);
+			++i;
+			++j;
+		}
+	}
+}
+
+// Intersection by exponential search of each element of the small
+// set in the large set
+static void intersectGallop(const uint32_t *Small, size_t NS,
+		const uint32_t *Large, size_t NL, vector<uint32_t> &Out) {
+
+	size_t lo = 0;
+	for (size_t i = 0; i < NS && lo < NL; ++i) {
+		uint32_t Key = Small[i];
+		size_t step = 1, hi = lo;
+		while (hi < NL && Large[hi] < Key) {
+			lo = hi + 1;
+			hi += step;
+			step <<= 1;
+		}
+		if (hi > NL)
+			hi = NL;
+		const uint32_t *P = std::lower_bound(Large + lo, Large + hi, Key);
+		lo = P - Large;
+		if (lo < NL && Large[lo] == Key)
+			Out.push_back(Key);
+	}
+}
+
+#ifdef __SSE2__
+// Compare blocks of four elements against each other, with all
+// rotations of the block of B
+static void intersectSSE(const uint32_t *A, size_t NA,
+		const uint32_t *B, size_t NB, vector<uint32_t> &Out) {
+
+	size_t i = 0, j = 0;
+	while (i + 4 <= NA && j + 4 <= NB) {
+		__m128i VA = _mm_loadu_si128((const __m128i *)(A + i));
+		__m128i VB = _mm_loadu_si128((const __m128i *)(B + j));
+
+		__m128i Cmp = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi32(VA, VB),
+					_mm_cmpeq_epi32(VA, _mm_shuffle_epi32(VB, 0x39))),
+				_mm_or_si128(
+					_mm_cmpeq_epi32(VA, _mm_shuffle_epi32(VB, 0x4e)),
+					_mm_cmpeq_epi32(VA, _mm_shuffle_epi32(VB, 0x93))));
+		int Mask = _mm_movemask_ps(_mm_castsi128_ps(Cmp));
+		for (int k = 0; Mask; ++k, Mask >>= 1) {
+			if (Mask & 1)
+				Out.push_back(A[i + k]);
+		}
+
+		uint32_t MaxA = A[i + 3], MaxB = B[j + 3];
+		if (MaxA <= MaxB)
+			i += 4;
+		if (MaxB <= MaxA)
+			j += 4;
+	}
+
+	intersectScalar(A + i, NA - i, B + j, NB - j, Out);
+}
+#endif
+
+void FuncIDSet::intersect(const FuncIDSet &S1, const FuncIDSet &S2,
+		FuncIDSet &Out) {
+
+	Out.Elems.clear();
+
+	const uint32_t *A = S1.data(), *B = S2.data();
+	size_t NA = S1.size(), NB = S2.size();
+	if (NA == 0 || NB == 0)
+		return;
+	if (NA > NB) {
+		std::swap(A, B);
+		std::swap(NA, NB);
+	}
+	// Disjoint ranges
+	if (A[NA - 1] < B[0] || B[NB - 1] < A[0])
+		return;
+
+	Out.Elems.reserve(NA);
+	if (NA * GALLOP_RATIO < NB)
+		intersectGallop(A, NA, B, NB, Out.Elems);
+	else
+#ifdef __SSE2__
+		intersectSSE(A, NA, B, NB, Out.Elems);
+#else
+		intersectScalar(A, NA, B, NB, Out.Elems);
+#endif
+}
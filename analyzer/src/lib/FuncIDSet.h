@@ -0,0 +1,61 @@
+#ifndef FUNC_ID_SET_H
+#define FUNC_ID_SET_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//
+// A set of functions represented by their dense IDs (see
+// GlobalContext::getFuncID), stored as a sorted array. Intersections
+// of such sets are much cheaper than probing a pointer set per
+// element.
+//
+class FuncIDSet {
+
+	public:
+		typedef vector<uint32_t>::const_iterator iterator;
+
+		FuncIDSet() { }
+
+		// Build the set from unsorted, possibly duplicated IDs
+		void assign(vector<uint32_t> &IDs) {
+			std::sort(IDs.begin(), IDs.end());
+			IDs.erase(std::unique(IDs.begin(), IDs.end()), IDs.end());
+			Elems.swap(IDs);
+		}
+
+		void insert(uint32_t ID) {
+			auto it = std::lower_bound(Elems.begin(), Elems.end(), ID);
+			if (it == Elems.end() || *it != ID)
+				Elems.insert(it, ID);
+		}
+
+		bool count(uint32_t ID) const {
+			return std::binary_search(Elems.begin(), Elems.end(), ID);
+		}
+
+		size_t size() const { return Elems.size(); }
+		bool empty() const { return Elems.empty(); }
+		void clear() { Elems.clear(); }
+		void swap(FuncIDSet &Other) { Elems.swap(Other.Elems); }
+		const uint32_t *data() const { return Elems.data(); }
+
+		iterator begin() const { return Elems.begin(); }
+		iterator end() const { return Elems.end(); }
+
+		friend bool operator== (const FuncIDSet &S1, const FuncIDSet &S2) {
+			return S1.Elems == S2.Elems;
+		}
+
+		// Out = S1 & S2. Out must not alias S1 or S2.
+		static void intersect(const FuncIDSet &S1, const FuncIDSet &S2,
+				FuncIDSet &Out);
+
+	private:
+		vector<uint32_t> Elems;
+};
+
+#endif
@@ -0,0 +1,83 @@
+//===-- MemoryDefUse.cc - Reaching stores with MemorySSA--------===//
+//
+// This file builds MemorySSA for a function and walks it to find the
+// memory definitions that reach a load. MemorySSA is built on demand
+// and kept in the global context with the other per-function
+// analyses.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/ADT/SmallPtrSet.h>
+
+#include "MemoryDefUse.h"
+#include "Analyzer.h"
+
+MemoryDefUse::MemoryDefUse(Function *F, ModuleOracle &MO) {
+
+	TargetLibraryInfo &TLI = MO.getTargetLibraryInfo();
+	DT = make_unique<DominatorTree>(*F);
+	AC = make_unique<AssumptionCache>(*F);
+	BAR = make_unique<BasicAAResult>(MO.getDataLayout(), *F, TLI, *AC,
+			DT.get());
+	AAR = make_unique<AAResults>(TLI);
+	AAR->addAAResult(*BAR);
+	MSSA = make_unique<MemorySSA>(*F, AAR.get(), DT.get());
+}
+
+void MemoryDefUse::getReachingDefs(LoadInst *LI,
+		SmallVectorImpl<Instruction *> &Defs) {
+
+	MemoryUseOrDef *MU = MSSA->getMemoryAccess(LI);
+	if (!MU)
+		return;
+	MemoryLocation Loc = MemoryLocation::get(LI);
+
+	// The defining access of the load is its nearest clobber; from
+	// there, definitions are chained in program order
+	SmallPtrSet<MemoryAccess *, 16> Visited;
+	SmallVector<MemoryAccess *, 16> Worklist;
+	Worklist.push_back(MU->getDefiningAccess());
+	while (!Worklist.empty()) {
+		MemoryAccess *MA = Worklist.pop_back_val();
+		if (!Visited.insert(MA).second || MSSA->isLiveOnEntryDef(MA))
+			continue;
+
+		if (MemoryPhi *MP = dyn_cast<MemoryPhi>(MA)) {
+			for (auto &Op : MP->incoming_values())
+				Worklist.push_back(cast<MemoryAccess>(Op));
+			continue;
+		}
+
+		MemoryDef *MD = cast<MemoryDef>(MA);
+		Instruction *I = MD->getMemoryInst();
+		if (isModSet(AAR->getModRefInfo(I, Loc))) {
+			Defs.push_back(I);
+			StoreInst *SI = dyn_cast<StoreInst>(I);
+			if (SI && AAR->alias(MemoryLocation::get(SI), Loc) == MustAlias)
+				continue;
+		}
+		Worklist.push_back(MD->getDefiningAccess());
+	}
+}
+
+void MemoryDefUse::getReachingStores(LoadInst *LI, Value *Ptr,
+		SmallVectorImpl<StoreInst *> &Stores) {
+
+	SmallVector<Instruction *, 8> Defs;
+	getReachingDefs(LI, Defs);
+	for (Instruction *I : Defs) {
+		StoreInst *SI = dyn_cast<StoreInst>(I);
+		if (SI && SI->getPointerOperand() == Ptr)
+			Stores.push_back(SI);
+	}
+}
+
+MemoryDefUse &GlobalContext::getMemoryDefUse(Function *F) {
+
+	ModuleOracle &MO = getModuleOracle(F->getParent());
+	lock_guard<mutex> Lock(MemoryDefUseMutex);
+	unique_ptr<MemoryDefUse> &MDU = MemoryDefUses[F];
+	if (!MDU)
+		MDU = make_unique<MemoryDefUse>(F, MO);
+	return *MDU;
+}
@@ -0,0 +1,48 @@
+#ifndef MEMORY_DEF_USE_H
+#define MEMORY_DEF_USE_H
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/Analysis/BasicAliasAnalysis.h>
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/MemorySSA.h>
+#include <llvm/ADT/SmallVector.h>
+#include <memory>
+
+using namespace llvm;
+using namespace std;
+
+class ModuleOracle;
+
+//
+// Def-use of memory in a function, with MemorySSA over basic AA.
+// The stores that may reach a load are found by walking the memory
+// definitions up from the load, instead of scanning the function and
+// the CFG for each candidate store.
+//
+class MemoryDefUse {
+
+	public:
+		MemoryDefUse(Function *F, ModuleOracle &MO);
+
+		// Collect the instructions that may write the memory read by
+		// LI and reach it: stores, and calls that may modify it. A
+		// path ends at a store to the same location.
+		void getReachingDefs(LoadInst *LI,
+				SmallVectorImpl<Instruction *> &Defs);
+
+		// The stores to Ptr among the reaching definitions of LI
+		void getReachingStores(LoadInst *LI, Value *Ptr,
+				SmallVectorImpl<StoreInst *> &Stores);
+
+	private:
+		unique_ptr<DominatorTree> DT;
+		unique_ptr<AssumptionCache> AC;
+		unique_ptr<BasicAAResult> BAR;
+		unique_ptr<AAResults> AAR;
+		unique_ptr<MemorySSA> MSSA;
+};
+
+#endif
@@ -11,6 +11,7 @@
 
 #include "MissingChecks.h"
 #include "Config.h"
+#include "PointerAnalysis.h"
 
 
 ////////////////////////////////////////////////////////////
@@ -102,13 +103,10 @@ void MissingChecksPass::collectAliasPointers(Function *F, LoadInst
 	if (!AI)
 		return;
 
-	for (inst_iterator i = inst_begin(F), ei = inst_end(F); i != ei; ++i) {
-		StoreInst *SI = dyn_cast<StoreInst>(&*i);
-		if (!SI) 
-			continue;
-		if (SI->getPointerOperand() == LPO && DFA.possibleUseStResult(LI, SI))
-			AliasSet.insert(SI->getValueOperand());
-	}
+	SmallVector<StoreInst *, 8> Stores;
+	Ctx->getMemoryDefUse(F).getReachingStores(LI, LPO, Stores);
+	for (StoreInst *SI : Stores)
+		AliasSet.insert(SI->getValueOperand());
 }
 
 /// Find the sources of a given value
@@ -159,27 +157,22 @@ void MissingChecksPass::findSourceCV(Value *V, set<Value *> &CVSet,
 
 	if (LoadInst *LI = dyn_cast<LoadInst>(V)) {
 
-		Value *LPO = LI->getPointerOperand();
 		Function *F = LI->getParent()->getParent();
-		std::set<Value *> AliasSet;
-
-		DFA.getAliasPointers(LI->getPointerOperand(), AliasSet,
-				Ctx->FuncPAResults[F]);
-
-		set<BasicBlock *> reachBBs;
-		DFA.collectPredReachBlocks(LI->getParent(), reachBBs);
-		//Check the storeInst that precedes the loadInst
+		AliasClass AliasSet = DFA.getAliasPointers(LI->getPointerOperand(), F);
+		SmallPtrSet<Value *, 8> Aliases;
 		for (Value *A : AliasSet) {
-			for (User *U : A->users()) {
+			if (DFA.isLocalTo(A, F))
+				Aliases.insert(A);
+		}
 
-				StoreInst *SI = dyn_cast<StoreInst>(U);
-				if (SI && A == SI->getPointerOperand()) {
-					// The StoreInst must be in a pred reachable block
-					if (reachBBs.find(SI->getParent()) == reachBBs.end())
-						continue;
-					Value *SVO = SI->getValueOperand();
-					findSourceCV(SVO, CVSet, TrackedSet);
-				}
+		//Check the storeInsts to aliases that reach the loadInst
+		SmallVector<Instruction *, 8> Defs;
+		Ctx->getMemoryDefUse(F).getReachingDefs(LI, Defs);
+		for (Instruction *I : Defs) {
+			StoreInst *SI = dyn_cast<StoreInst>(I);
+			if (SI && Aliases.count(SI->getPointerOperand())) {
+				Value *SVO = SI->getValueOperand();
+				findSourceCV(SVO, CVSet, TrackedSet);
 			}
 		}
 		// FIXME: further track LoadInst?
@@ -289,8 +282,8 @@ void MissingChecksPass::findClosestBranch (Value *Src, Value *SC,
 		if (!CF)
 			return;
 
-		if (Ctx->Callees[CI].size())
-			CF = *(Ctx->Callees[CI].begin());
+		if (Function *RF = Ctx->CallGraph.getResolvedCallee(CI))
+			CF = RF;
 		if (!CF) 
 			return;
 
@@ -319,6 +312,7 @@ void MissingChecksPass::findClosestBranch (Value *Src, Value *SC,
 	if (!I)
 		return;
 
+	const CFGOverlay &CFG = Ctx->getCFGOverlay(I->getFunction());
 	EB.push_back(I->getParent());
 
 	while (!EB.empty()) {
@@ -328,11 +322,11 @@ void MissingChecksPass::findClosestBranch (Value *Src, Value *SC,
 			continue;
 		PB.insert(TB);
 
-		for (BasicBlock *Pred : predecessors(TB)) {
+		for (BasicBlock *Pred : CFG.predecessors(TB)) {
 			// Check if it is a branch instruction
 			Instruction *TI = Pred->getTerminator();
 			if (TI->getNumSuccessors() > 1) {
-				for (BasicBlock *Succ : successors(Pred)) {
+				for (BasicBlock *Succ : CFG.successors(Pred)) {
 					if (TB == Succ)
 						continue;
 
@@ -387,9 +381,9 @@ void MissingChecksPass::isCheckedBackward(Function *F, use_t Use,
 			return;
 
 		Function *PF = Arg->getParent();
-		if (!PF || Ctx->Callers.find(PF) == Ctx->Callers.end())
+		if (!PF || !Ctx->CallGraph.hasCallers(PF))
 			return;
-		for (auto CI : Ctx->Callers[PF]) {
+		for (auto CI : Ctx->CallGraph.getCallers(PF)) {
 			if (ArgNo >= CI->getNumArgOperands())
 				continue;
 
@@ -465,9 +459,7 @@ void MissingChecksPass::isCheckedBackward(Function *F, use_t Use,
 
 	if (LoadInst* LI = dyn_cast<LoadInst>(V)) {
 
-		set<Value *> AliasSet;
-		DFA.getAliasPointers(LI->getPointerOperand(), AliasSet,
-				Ctx->FuncPAResults[F]);
+		AliasClass AliasSet = DFA.getAliasPointers(LI->getPointerOperand(), F);
 
 		for (Value *A : AliasSet) {
 			for (User *SU : A->users()) {
@@ -475,6 +467,23 @@ void MissingChecksPass::isCheckedBackward(Function *F, use_t Use,
 				// Filtering
 				if (!SUI)
 					continue;
+
+				// A store of another function through an alias: check
+				// the stored value in the blocks of that function
+				// reaching the store
+				Function *SF = SUI->getParent()->getParent();
+				if (SF != F) {
+					StoreInst *SSI = dyn_cast<StoreInst>(SU);
+					if (!SSI || SSI->getPointerOperand() != A)
+						continue;
+					set<BasicBlock *> predBBs;
+					DFA.collectPredReachBlocks(SSI->getParent(), predBBs);
+					unsigned New_Depth = Depth + 1;
+					isCheckedBackward(SF, Use, SSI->getValueOperand(),
+							predBBs, VSet, isChecked, New_Depth);
+					continue;
+				}
+
 				if (Scope.find(SUI->getParent()) == Scope.end())
 					continue;
 
@@ -599,15 +608,17 @@ void MissingChecksPass::isCheckedForward(Function *F, src_t Src,
 
 		StoreInst *SI = dyn_cast<StoreInst>(UV);
 		if (SI && V == SI->getValueOperand()) {
-			std::set<Value *> AliasSet;
-			DFA.getAliasPointers(SI->getPointerOperand(), AliasSet,
-					Ctx->FuncPAResults[F]);
+			AliasClass AliasSet = DFA.getAliasPointers(SI->getPointerOperand(), F);
 			for (Value *A : AliasSet) {
 				for (User *SU : A->users()) {
 					LoadInst *LI = dyn_cast<LoadInst>(SU);
-					if (LI) {
+					if (!LI)
+						continue;
+					if (LI->getParent()->getParent() != F)
+						isLoadCheckedForward(LI, Src, VSet, isChecked, Depth);
+					else
 						isCheckedForward(F, Src, LI, Scope, VSet,
-								isChecked, Depth); }
+								isChecked, Depth);
 				}
 			}
 			continue;
@@ -641,6 +652,23 @@ void MissingChecksPass::isCheckedForward(Function *F, src_t Src,
 	}
 }
 
+/// Check a value loaded in another function, through an alias of a
+/// pointer the source was stored to, in the blocks reachable from
+/// the load
+void MissingChecksPass::isLoadCheckedForward(LoadInst *LI, src_t Src,
+		set<Value *> &VSet, bool &isChecked, unsigned &Depth) {
+
+	if (isChecked || Depth > 5)
+		return;
+
+	Function *LF = LI->getParent()->getParent();
+	set<BasicBlock *> reachBBs;
+	DFA.collectSuccReachBlocks(LI->getParent(), reachBBs);
+
+	unsigned New_Depth = Depth + 1;
+	isCheckedForward(LF, Src, LI, reachBBs, VSet, isChecked, New_Depth);
+}
+
 ModelSC MissingChecksPass::modelCheck(CmpInst *CmpI, 
 		Value *SrcUse, int8_t ArgNo) {
 
@@ -789,11 +817,7 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 					break;
 			}
 
-			for (auto CI : Ctx->Callers[F]) {
-				// Indirect call
-				if (CI->getCalledFunction() != NULL) {
-					continue;	
-				}
+			for (auto CI : Ctx->CallGraph.getIndirectCallers(F)) {
 				// Collect indirect calls and argument number as source
 				src_t Src = src_c(CI, ArgNo);
 				addSrcCheck(Src, modelCheck(dyn_cast<CmpInst>(SCI), 
@@ -805,8 +829,8 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 			Function *CF = CI->getCalledFunction();
 			if (!CF) continue;
 
-			if (Ctx->Callees[CI].size())
-				CF = *(Ctx->Callees[CI].begin());
+			if (Function *RF = Ctx->CallGraph.getResolvedCallee(CI))
+				CF = RF;
 			if (!CF) continue;
 
 			src_t Src = src_c(CF, -1);
@@ -835,8 +859,8 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 					Function *CF = CI->getCalledFunction();
 					if (!CF) continue;
 
-					if (Ctx->Callees[CI].size())
-						CF = *(Ctx->Callees[CI].begin());
+					if (Function *RF = Ctx->CallGraph.getResolvedCallee(CI))
+						CF = RF;
 					if (!CF) continue;
 
 					src_t Src = src_c(CF, ArgNo);
@@ -878,8 +902,8 @@ void MissingChecksPass::countSrcUseChecks(Function *F,
 					Function *CF = CI->getCalledFunction();
 					if (!CF) continue;
 
-					if (Ctx->Callees[CI].size())
-						CF = *(Ctx->Callees[CI].begin());
+					if (Function *RF = Ctx->CallGraph.getResolvedCallee(CI))
+						CF = RF;
 					if (!CF) continue;
 
 					use_t PUse = use_c(CF, Use.second);
@@ -909,7 +933,7 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 				auto Src = CheckedSrcSet.find(src_c(CI, ArgNo));
 				if (Src == CheckedSrcSet.end())
 					continue;
-				for (auto Callee : Ctx->Callees[CI]) {
+				for (auto Callee : Ctx->CallGraph.getCallees(CI)) {
 
 					Argument *PArg = getArgByNo(Callee, ArgNo);
 
@@ -924,17 +948,21 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 					DFA.collectSuccReachBlocks(&(Callee->getEntryBlock()), reachBBs);
 
 					set<Value *> ToTrackSet;
+					set<LoadInst *> CrossTrackSet;
 					ToTrackSet.insert(PArg);
 					if (PArg->getType()->isPointerTy()) {
-						set<Value *> AliasSet;
-						// A check may target loaded variables
-						DFA.getAliasPointers(PArg, AliasSet,
-								Ctx->FuncPAResults[Callee]);
+						// A check may target loaded variables, also
+						// in other functions
+						AliasClass AliasSet = DFA.getAliasPointers(PArg, Callee);
 						for (Value *A : AliasSet) {
 							for (User *U : A->users()) {
 								LoadInst *LI = dyn_cast<LoadInst>(U);
 								if (!LI)
 									continue;
+								if (LI->getParent()->getParent() != Callee) {
+									CrossTrackSet.insert(LI);
+									continue;
+								}
 								if (reachBBs.find(LI->getParent()) == reachBBs.end())
 									continue;
 								ToTrackSet.insert(LI);
@@ -948,6 +976,11 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 						if (isChecked)
 							break;
 					}
+					for (LoadInst *LI : CrossTrackSet) {
+						if (isChecked)
+							break;
+						isLoadCheckedForward(LI, *Src, VSet, isChecked, Depth);
+					}
 
 					if (!isChecked) {
 						addSrcUncheck(*Src, PArg);
@@ -969,18 +1002,13 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 
 		// Return value or parameter of a function call as a source
 		Function *CF = NULL;
-		if (Ctx->Callees[CI].size())
-			CF = *(Ctx->Callees[CI].begin());
+		if (Function *RF = Ctx->CallGraph.getResolvedCallee(CI))
+			CF = RF;
 		if (CF) {
-			// Skip the functions in the blacklist
-			// TODO: move these functions to Config.h or a file
-			if (CF->getName() == "outb"
-					|| CF->getName() == "__const_udelay" 
-					|| CF->getName() == "__udelay" 
-					|| CF->getName() == "scnprintf" 
-					|| CF->getName() == "__fswab16" 
-					|| CF->getName() == "__fswab32" 
-			   )
+			// Skip the functions in configs/skip-funcs
+			auto rit = Ctx->FuncRoleTable.find(CF);
+			if (rit != Ctx->FuncRoleTable.end()
+					&& (rit->second.Mask & FR_Skip))
 				continue;
 
 			int8_t ArgNo = -2;
@@ -1026,15 +1054,18 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 					else {
 						// A check should target the loaded value from the
 						// parameter
-						set<Value *> AliasSet;
 						set<Value *> ToTrackSet;
-						DFA.getAliasPointers(Param, AliasSet,
-								Ctx->FuncPAResults[F]);
+						set<LoadInst *> CrossTrackSet;
+						AliasClass AliasSet = DFA.getAliasPointers(Param, F);
 						for (Value *A : AliasSet) {
 							for (User *U : A->users()) {
 								LoadInst *LI = dyn_cast<LoadInst>(U);
 								if (!LI)
 									continue;
+								if (LI->getParent()->getParent() != F) {
+									CrossTrackSet.insert(LI);
+									continue;
+								}
 								if (reachBBs.find(LI->getParent()) == reachBBs.end())
 									continue;
 								ToTrackSet.insert(LI);
@@ -1046,6 +1077,11 @@ void MissingChecksPass::countSrcUseUnchecks(Function *F) {
 							if (isChecked)
 								break;
 						}
+						for (LoadInst *LI : CrossTrackSet) {
+							if (isChecked)
+								break;
+							isLoadCheckedForward(LI, *Src, VSet, isChecked, Depth);
+						}
 					}
 
 					if (!isChecked) {
@@ -1228,6 +1264,24 @@ bool MissingChecksPass::doModulePass(Module *M) {
 
 	++MIdx;
 
+	// Stage 1 queries the alias classes of the functions with
+	// security checks; with several threads, compute them up front
+	// in parallel. The global points-to analysis needs no classes.
+	if (AnalysisStage == 1 && getNumThreads() > 1 && !Ctx->PointsTo) {
+		vector<Function *> CheckFuncs;
+		for (Function &F : *M) {
+			if (F.empty() || F.size() > MAX_BLOCKS_SUPPORT)
+				continue;
+			if (Ctx->UnifiedFuncSet.find(&F) == Ctx->UnifiedFuncSet.end())
+				continue;
+			auto it = Ctx->CheckInstSets.find(&F);
+			if (it != Ctx->CheckInstSets.end() && !it->second.empty())
+				CheckFuncs.push_back(&F);
+		}
+		PointerAnalysisPass PAPass(Ctx);
+		PAPass.analyzeFunctions(CheckFuncs);
+	}
+
 	for(Module::iterator f = M->begin(), fe = M->end();
 			f != fe; ++f) {
 		Function *F = &*f;
@@ -1313,6 +1367,10 @@ bool MissingChecksPass::doModulePass(Module *M) {
 		}
 	}
 
+	// Alias classes and def-use of memory are computed for the
+	// queried functions only; release them once the module is done
+	Ctx->releaseFuncAnalyses();
+
 	if (Ctx->Modules.size() == MIdx) {
 		++AnalysisStage;
 		MIdx = 0;
@@ -101,6 +101,9 @@ class MissingChecksPass : public IterativeModulePass {
 				Value *V, set<BasicBlock *> &Scope, set<Value *> &VSet, 
 				bool &isChecked, unsigned &Depth, bool enableAlias=true);
 
+		void isLoadCheckedForward(LoadInst *LI, src_t Src,
+				set<Value *> &VSet, bool &isChecked, unsigned &Depth);
+
 		void isCheckedBackward(Function *F, use_t Use,
 				Value *V, set<BasicBlock *> &Scope, set<Value *> &VSet, 
 				bool &isChecked, unsigned &Depth);
@@ -1,7 +1,11 @@
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/InstIterator.h>
-#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/Analysis/BasicAliasAnalysis.h>
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
 
 #include "PointerAnalysis.h"
 
@@ -111,16 +115,13 @@ void PointerAnalysisPass::collectPointers(Function *F,
 	}
 }
 
-/// Detect aliased pointers in this function.
-void PointerAnalysisPass::detectAliasPointers(Function *F,
-		AAResults &AAR,
-		PointerAnalysisMap &aliasPtrs) {
+/// Collect the pointers that are loaded from, stored to, or passed
+/// to calls
+void PointerAnalysisPass::collectAddrs(Function *F,
+		vector<Value *> &Addrs) {
 
 	std::set<Value *> addr1Set;
-	std::set<Value *> addr2Set;
-	Value *Addr1, *Addr2;
 
-	// Collect interesting pointers
 	for (inst_iterator i = inst_begin(F), ei = inst_end(F);
 			i != ei; ++i) {
 
@@ -144,89 +145,185 @@ void PointerAnalysisPass::detectAliasPointers(Function *F,
 		}
 	}
 
-	// FIXME: avoid being stuck
-	if (addr1Set.size() > 1000) {
-		return;
-	}
+	Addrs.assign(addr1Set.begin(), addr1Set.end());
+}
 
-	for (auto Addr1 : addr1Set) {
+/// Detect aliased pointers in this function.
+void PointerAnalysisPass::detectAliasPointers(Function *F,
+		AAResults &AAR,
+		AliasClasses &aliasPtrs) {
+
+	vector<Value *> Addrs;
+	collectAddrs(F, Addrs);
+
+	// Group the pointers by their underlying objects and by their
+	// source pointers. Pointers based on distinct identified objects
+	// never alias, and MayAlias only counts for pointers with the
+	// same source, so only pointers sharing a group are queried.
+	// Results are symmetric, and aliased pointers are merged into
+	// classes, so pairs already in the same class are not queried.
+	const DataLayout &DL = F->getParent()->getDataLayout();
+	vector<Value *> Objs(Addrs.size()), Srcs(Addrs.size());
+	DenseMap<Value *, vector<uint32_t>> ObjGroups, SrcGroups;
+	for (uint32_t i = 0; i < Addrs.size(); ++i) {
+		Objs[i] = GetUnderlyingObject(Addrs[i], DL);
+		Srcs[i] = getSourcePointer(Addrs[i]);
+		ObjGroups[Objs[i]].push_back(i);
+		SrcGroups[Srcs[i]].push_back(i);
+	}
 
-		for (auto Addr2 : addr1Set) {
+	UnionFind Classes(Addrs.size());
+	auto queryPair = [&](uint32_t i, uint32_t j) {
 
-			if (Addr1 == Addr2)
-				continue;
+		if (Classes.find(i) == Classes.find(j))
+			return;
 
-			AliasResult AResult = AAR.alias(Addr1, Addr2);
+		AliasResult AResult = AAR.alias(Addrs[i], Addrs[j]);
 
-			bool notAlias = true;
+		bool notAlias = true;
 
-			if (AResult == MustAlias || AResult == PartialAlias)
-				notAlias = false;
+		if (AResult == MustAlias || AResult == PartialAlias)
+			notAlias = false;
 
-			else if (AResult == MayAlias) {
+		else if (AResult == MayAlias) {
 #ifdef MUST_ALIAS
-				if (getSourcePointer(Addr1) == getSourcePointer(Addr2))
-					notAlias = false;
-#else
+			if (Srcs[i] == Srcs[j])
 				notAlias = false;
+#else
+			notAlias = false;
 #endif
-			}
+		}
 
-			if (notAlias)
-				continue;
+		if (notAlias)
+			return;
 
-			auto as = aliasPtrs.find(Addr1);
-			if (as == aliasPtrs.end()) {
-				SmallPtrSet<Value *, 16> sv;
-				sv.insert(Addr2);
-				aliasPtrs[Addr1] = sv;
-			} 
-			else {
-				as->second.insert(Addr2);
-			}
+		Classes.unite(i, j);
+	};
+
+#ifdef MUST_ALIAS
+	for (auto *Groups : {&ObjGroups, &SrcGroups}) {
+		for (auto &G : *Groups) {
+			vector<uint32_t> &Members = G.second;
+			for (size_t m = 0; m < Members.size(); ++m)
+				for (size_t n = m + 1; n < Members.size(); ++n)
+					queryPair(Members[m], Members[n]);
+		}
+	}
+#else
+	// Any pointers not based on distinct identified objects may alias
+	for (uint32_t i = 0; i < Addrs.size(); ++i) {
+		for (uint32_t j = i + 1; j < Addrs.size(); ++j) {
+			if (Objs[i] != Objs[j] && isIdentifiedObject(Objs[i])
+					&& isIdentifiedObject(Objs[j]))
+				continue;
+			queryPair(i, j);
 		}
 	}
+#endif
+
+	aliasPtrs.build(Addrs, Classes);
 }
 
-bool PointerAnalysisPass::doModulePass(Module *M) {
+/// Run basic alias analysis on this function alone and detect its
+/// aliased pointers. The AA pipeline only lives during the detection.
+/// XXX: more complicated alias analyses may be required.
+void PointerAnalysisPass::analyzeFunction(Function *F, ModuleOracle &MO,
+		AliasClasses &aliasPtrs) {
+
+	TargetLibraryInfo &TLI = MO.getTargetLibraryInfo();
+	DominatorTree DT(*F);
+
+	// The assumptions are scanned up front, so that queries only
+	// read the cache
+	unique_ptr<AssumptionCache> AC;
+	{
+		lock_guard<mutex> Lock(Ctx->AssumptionMutex);
+		AC = make_unique<AssumptionCache>(*F);
+		AC->assumptions();
+	}
 
-	// Save TargetLibraryInfo.
-	Triple ModuleTriple(M->getTargetTriple());
-	TargetLibraryInfoImpl TLII(ModuleTriple);
-	TLI = new TargetLibraryInfo(TLII);
+	{
+		BasicAAResult BAR(MO.getDataLayout(), *F, TLI, *AC, &DT);
+		AAResults AAR(TLI);
+		AAR.addAAResult(BAR);
 
-	// Run BasicAliasAnalysis pass on each function in this module.
-	// XXX: more complicated alias analyses may be required.
-	legacy::FunctionPassManager *FPasses = new legacy::FunctionPassManager(M);
-	AAResultsWrapperPass *AARPass = new AAResultsWrapperPass();
+		detectAliasPointers(F, AAR, aliasPtrs);
+	}
+
+	lock_guard<mutex> Lock(Ctx->AssumptionMutex);
+	AC.reset();
+}
+
+void PointerAnalysisPass::analyzeFunctions(ArrayRef<Function *> Funcs) {
+
+	unsigned NumThreads = getNumThreads();
+	vector<DenseMap<Module *, unique_ptr<ModuleOracle>>>
+		WorkerOracles(NumThreads);
+	parallelFor(Funcs.size(), NumThreads, [&](size_t i, unsigned t) {
+		Function *F = Funcs[i];
+		AliasClasses Classes;
+		if (!F->empty()) {
+			Module *M = F->getParent();
+			unique_ptr<ModuleOracle> &MO = WorkerOracles[t][M];
+			if (!MO)
+				MO = make_unique<ModuleOracle>(*M);
+			analyzeFunction(F, *MO, Classes);
+		}
+		Ctx->publishAliasClasses(F, std::move(Classes));
+	});
+}
 
-	FPasses->add(AARPass);
+/// Compute the alias classes of all functions of the module up
+/// front. The analyses query them through
+/// GlobalContext::getAliasClasses(), which computes them on demand
+/// anyway.
+bool PointerAnalysisPass::doModulePass(Module *M) {
 
-	FPasses->doInitialization();
+	vector<Function *> Funcs;
 	for (Function &F : *M) {
-		if (F.isDeclaration())
+		if (F.empty() || Ctx->hasAliasClasses(&F))
 			continue;
-		FPasses->run(F);
+		Funcs.push_back(&F);
 	}
-	FPasses->doFinalization();
+	analyzeFunctions(Funcs);
 
-	// Basic alias analysis result.
-	AAResults &AAR = AARPass->getAAResults();
+	return false;
+}
 
-	for (Module::iterator f = M->begin(), fe = M->end();
-			f != fe; ++f) {
-		Function *F = &*f;
-		PointerAnalysisMap aliasPtrs;
+ModuleOracle &GlobalContext::getModuleOracle(Module *M) {
 
-		if (F->empty())
-			continue;
+	lock_guard<mutex> Lock(ModuleOracleMutex);
+	unique_ptr<ModuleOracle> &MO = ModuleOracles[M];
+	if (!MO)
+		MO = make_unique<ModuleOracle>(*M);
+	return *MO;
+}
 
-		detectAliasPointers(F, AAR, aliasPtrs);
+const AliasClasses &GlobalContext::getAliasClasses(Function *F) {
 
-		// Save pointer analysis result.
-		Ctx->FuncPAResults[F] = aliasPtrs;
-		Ctx->FuncAAResults[F] = &AAR;
+	{
+		lock_guard<mutex> Lock(AliasClassesMutex);
+		auto it = FuncPAResults.find(F);
+		if (it != FuncPAResults.end())
+			return it->second;
 	}
 
-	return false;
+	// Declarations have no aliased pointers. The classes are
+	// computed without holding the lock.
+	AliasClasses Classes;
+	if (!F->empty()) {
+		PointerAnalysisPass PAPass(this);
+		PAPass.analyzeFunction(F, getModuleOracle(F->getParent()), Classes);
+	}
+	return publishAliasClasses(F, std::move(Classes));
+}
+
+const AliasClasses &GlobalContext::publishAliasClasses(Function *F,
+		AliasClasses &&Classes) {
+
+	// Elements of FuncPAResults are never moved by insertions, so
+	// the returned reference stays valid until the classes are
+	// released
+	lock_guard<mutex> Lock(AliasClassesMutex);
+	return FuncPAResults.emplace(F, std::move(Classes)).first->second;
 }
@@ -7,12 +7,12 @@ class PointerAnalysisPass : public IterativeModulePass {
 	typedef std::pair<Value *, MemoryLocation *> AddrMemPair;
 
 	private:
-	TargetLibraryInfo *TLI;
-
 	void collectPointers(Function *, set<Value *> &PSet);
 
+	void collectAddrs(Function *, vector<Value *> &Addrs);
+
 	void detectAliasPointers(Function *, AAResults &,
-			PointerAnalysisMap &);
+			AliasClasses &);
 
 	void augmentMustAlias(Function *F, Value *P, set<Value *> &ASet);
 	Value *getSourcePointer(Value *);
@@ -20,6 +20,16 @@ class PointerAnalysisPass : public IterativeModulePass {
 	public:
 	PointerAnalysisPass(GlobalContext *Ctx_)
 		: IterativeModulePass(Ctx_, "PointerAnalysis") { }
+
+	// Compute the alias classes of F with its own AA pipeline, using
+	// the analysis context of its module
+	void analyzeFunction(Function *F, ModuleOracle &MO,
+			AliasClasses &aliasPtrs);
+
+	// Compute and publish the alias classes of Funcs with
+	// getNumThreads() workers, each with its own module contexts
+	void analyzeFunctions(ArrayRef<Function *> Funcs);
+
 	virtual bool doInitialization(llvm::Module *);
 	virtual bool doFinalization(llvm::Module *);
 	virtual bool doModulePass(llvm::Module *);
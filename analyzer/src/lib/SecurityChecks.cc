@@ -15,6 +15,7 @@
 #include <regex>
 
 #include "SecurityChecks.h"
+#include "CallGraphSCC.h"
 #include "Config.h"
 #include "Common.h"
 
@@ -26,12 +27,18 @@
 #define ERR_RETURN_MASK 0xF
 #define ERR_HANDLE_MASK 0xF0
 
+// *printk calls at this log level (KERN_WARNING) or a more severe
+// one handle errors
+#define ERR_PRINTK_LEVEL 4
+
 // 1: only consider pre-defined default error codes such as EFAULT; 
 // 2: default error codes + <-4095, -1> + NULL pointer
 #define ERRNO_TYPE 	2
 
 //#define DEBUG_PRINT
 //#define TEST_CASE
+// Check the mayReturnErr() summaries against walks over callees
+//#define VERIFY_ERR_SUMMARIES
 
 // Refine the assembly functions to detect more SecurityChecks
 //#define ASM_FUNC
@@ -42,6 +49,9 @@ using namespace std;
 
 // SelectInsts that take error codes
 set<Instruction *>SecurityChecksPass::ErrSelectInstSet;
+DenseMap<Function *, bool>SecurityChecksPass::MayReturnErrMap;
+bool SecurityChecksPass::ErrSummariesBuilt = false;
+DenseMap<CallInst *, bool>SecurityChecksPass::ErrPrintkMap;
 
 /// Check if the value is an errno.
 bool SecurityChecksPass::isValueErrno(Value *V, Function *F) {
@@ -49,8 +59,20 @@ bool SecurityChecksPass::isValueErrno(Value *V, Function *F) {
 	if (!V)
 		return false;
 
+	// Only constants are errnos
+	Constant *C = dyn_cast<Constant>(V);
+	if (!C)
+		return false;
+
+	return isConstErrno(C, F->getReturnType()->isPointerTy());
+}
+
+/// Check if the constant is an errno in a function that returns a
+/// pointer or not.
+bool SecurityChecksPass::isConstErrno(Constant *C, bool RetPtr) {
+
 	// The value is a constant integer.
-	if (ConstantInt *CI = dyn_cast<ConstantInt>(V)) {
+	if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
 		const int64_t value = CI->getValue().getSExtValue();
 		// The value is an errno (negative or positive).
 		if (is_errno(-value) || is_errno(value)
@@ -63,20 +85,18 @@ bool SecurityChecksPass::isValueErrno(Value *V, Function *F) {
 	}
 
 #if ERRNO_TYPE == 2
-	if (ConstantPointerNull *CPN = dyn_cast<ConstantPointerNull>(V)) {
-		if (F->getReturnType()->isPointerTy())
+	if (isa<ConstantPointerNull>(C)) {
+		if (RetPtr)
 			return true;
 	}
 #endif
 
 	// The value is a constant expression.
-	if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
-		if (CE) {
-			for (unsigned i = 0, e = CE->getNumOperands();
-					i != e; ++i) {
-				if (isValueErrno(CE->getOperand(i), F))
-					return true;
-			}
+	if (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+		for (unsigned i = 0, e = CE->getNumOperands();
+				i != e; ++i) {
+			if (isConstErrno(CE->getOperand(i), RetPtr))
+				return true;
 		}
 	}
 
@@ -84,21 +104,13 @@ bool SecurityChecksPass::isValueErrno(Value *V, Function *F) {
 }
 
 /// Dump the marked CFG edges.
-void SecurityChecksPass::dumpErrEdges(EdgeErrMap &edgeErrMap) {
-	for (auto it = edgeErrMap.begin(); it != edgeErrMap.end(); ++it) {
-		CFGEdge edge = it->first;
-		int flag = it->second;
-		Instruction *TI = edge.first;
-
-		if (NULL == TI) {
-			OP << "    An errno ";
-			OP << (flag & Must_Return_Err ? "must" : "may");
-			OP << " be returned.\n";
-			continue;
-		}
+void SecurityChecksPass::dumpErrEdges(const CFGOverlay &CFG,
+		EdgeErrMap &edgeErrMap) {
+	for (uint32_t E = 0; E < edgeErrMap.size(); ++E) {
+		int flag = edgeErrMap[E];
 
-		BasicBlock *predBB = TI->getParent();
-		BasicBlock *succBB = edge.second;
+		BasicBlock *predBB = CFG.getBlock(CFG.getEdgeSrc(E));
+		BasicBlock *succBB = CFG.getBlock(CFG.getEdgeDst(E));
 
 		OP << "    ";
 		predBB->printAsOperand(OP, false);
@@ -243,10 +255,8 @@ void SecurityChecksPass::markBBErr(BasicBlock *BB,
 	
 	assert(BB);
 
-	if (bbErrMap.count(BB) != 0)
-		bbErrMap[BB] |= flag;
-	else
-		bbErrMap[BB] = flag;
+	const CFGOverlay &CFG = Ctx->getCFGOverlay(BB->getParent());
+	bbErrMap[CFG.getBlockID(BB)] |= flag;
 
 #ifdef DEBUG_PRINT
 	OP << "# Marking "<<flag<<" for basic block ";
@@ -256,81 +266,69 @@ void SecurityChecksPass::markBBErr(BasicBlock *BB,
 }
 
 /// Recursively mark all edges from the given block
-void SecurityChecksPass::recurMarkEdgesFromBlock(CFGEdge &CE, int flag, 
-		BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap) {
-
-	BasicBlock *BB = CE.second;
+void SecurityChecksPass::recurMarkEdgesFromBlock(const CFGOverlay &CFG,
+		uint32_t CE, int flag, BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap,
+		MarkWalkState &WS) {
 
 	// If BB resets the error, stop tracking
-	if (bbErrMap.count(BB) != 0 && bbErrMap[BB] & ERR_RETURN_MASK)
+	if (bbErrMap[CFG.getEdgeDst(CE)] & ERR_RETURN_MASK)
 		return;
 
-	Instruction *TI;
-
-	std::set<CFGEdge> PE;
-	std::list<std::pair<CFGEdge, int>> EEP;
-	PE.clear();
-	EEP.clear();
+	vector<char> &PE = WS.VisitedEdges;
+	vector<std::pair<uint32_t, int>> &EEP = WS.EdgeWork;
+	size_t Head = 0;
 
 	EEP.push_back(std::make_pair(CE, flag));
-	while (!EEP.empty()) {
+	while (Head < EEP.size()) {
 
-		std::pair<CFGEdge, int> TEP = EEP.front();
-		EEP.pop_front();
-		if (PE.count(TEP.first) != 0)
+		std::pair<uint32_t, int> TEP = EEP[Head++];
+		if (PE[TEP.first])
 			continue;
-		PE.insert(TEP.first);
+		PE[TEP.first] = 1;
 
-		BasicBlock *TB = TEP.first.second;
-		// Iterate on each successor basic block.
-		TI = TB->getTerminator();
+		BasicBlock *TB = CFG.getBlock(CFG.getEdgeDst(TEP.first));
 		// No successors, stop
-		if (TI->getNumSuccessors() == 0)
+		if (CFG.successors(TB).empty())
 			continue;
 
 		// Integrate flags of all incoming edges
 		int IntFlag = TEP.second;
-		for (BasicBlock *PredBB : predecessors(TB)) {
-			if (PredBB == TEP.first.first->getParent())
+		for (uint32_t PredE : CFG.predEdgeIDs(TB)) {
+			if (PredE == TEP.first)
 				continue;
-			Instruction *TI = PredBB->getTerminator();
-			CFGEdge Edge = std::make_pair(TI, TB);
-			if (edgeErrMap.count(Edge) == 0)
-				edgeErrMap[Edge] = 0;
-			mergeFlag(IntFlag, edgeErrMap[Edge]);
+			mergeFlag(IntFlag, edgeErrMap[PredE]);
 		}
-		for (BasicBlock *Succ : successors(TB)) {
-			CFGEdge CE = std::make_pair(TI, Succ);
-			if ((IntFlag & ERR_RETURN_MASK) != (edgeErrMap[CE] & ERR_RETURN_MASK)) {
-				updateReturnFlag(edgeErrMap[CE], IntFlag);
-				EEP.push_back(std::make_pair(CE, IntFlag));
+		// Iterate on each successor basic block.
+		for (uint32_t SuccE : CFG.succEdgeIDs(TB)) {
+			if ((IntFlag & ERR_RETURN_MASK) != (edgeErrMap[SuccE] & ERR_RETURN_MASK)) {
+				updateReturnFlag(edgeErrMap[SuccE], IntFlag);
+				EEP.push_back(std::make_pair(SuccE, IntFlag));
 			}
 		}
 	}
+	WS.clearEdges();
 }
 
 /// Recursively mark all edges to the given block
-void SecurityChecksPass::recurMarkEdgesToBlock(CFGEdge &CE, int flag, 
-		BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap) {
+void SecurityChecksPass::recurMarkEdgesToBlock(const CFGOverlay &CFG,
+		uint32_t CE, int flag, BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap,
+		MarkWalkState &WS) {
 
-	Instruction *TI;
-	std::set<CFGEdge> PE;
-	std::list<std::pair<CFGEdge, int>> EEP;
-	PE.clear();
-	EEP.clear();
+	vector<char> &PE = WS.VisitedEdges;
+	vector<std::pair<uint32_t, int>> &EEP = WS.EdgeWork;
+	size_t Head = 0;
 
 	EEP.push_back(std::make_pair(CE, flag));
-	while (!EEP.empty()) {
+	while (Head < EEP.size()) {
 
-		std::pair<CFGEdge, int> TEP = EEP.front();
-		EEP.pop_front();
-		if (PE.count(TEP.first) != 0)
+		std::pair<uint32_t, int> TEP = EEP[Head++];
+		if (PE[TEP.first])
 			continue;
-		PE.insert(TEP.first);
+		PE[TEP.first] = 1;
 
-		BasicBlock *TB = TEP.first.first->getParent();
+		BasicBlock *TB = CFG.getBlock(CFG.getEdgeSrc(TEP.first));
 		// No predecessors, stop
-		if (pred_size(TB) == 0)
+		if (CFG.predecessors(TB).empty())
 			continue;
 
 		int IntFlag = TEP.second;
@@ -341,23 +339,19 @@ void SecurityChecksPass::recurMarkEdgesToBlock(CFGEdge &CE, int flag,
 		// If the current edge is May_Return_Err, all predecessor edges 
 		// become May_Return_Err 
 		if (IntFlag & May_Return_Err) {
-			recurMarkEdgesToErrReturn(TB, May_Return_Err, edgeErrMap);
+			recurMarkEdgesToErrReturn(CFG, TB, May_Return_Err, edgeErrMap, WS);
 			continue;
 		}
 
 		// The current edge is Must_Return_Err
 		// Integrate flags of all outgoing edges
 		bool AllMust = true, AllZero = true;
-		for (BasicBlock *Succ : successors(TB)) {
-			if (Succ == TEP.first.second)
+		for (uint32_t SuccE : CFG.succEdgeIDs(TB)) {
+			if (SuccE == TEP.first)
 				continue;
-			CFGEdge Edge = std::make_pair(TB->getTerminator(), Succ);
-			//if (edgeErrMap.count(Edge) == 0) {
-			//	edgeErrMap[Edge] = 0;
-			//}
-			if (!(edgeErrMap[Edge] & Must_Return_Err))
+			if (!(edgeErrMap[SuccE] & Must_Return_Err))
 				AllMust = false;
-			else if (edgeErrMap[Edge] & May_Return_Err) {
+			else if (edgeErrMap[SuccE] & May_Return_Err) {
 				AllMust = false;
 				AllZero = false;
 			}
@@ -370,18 +364,15 @@ void SecurityChecksPass::recurMarkEdgesToBlock(CFGEdge &CE, int flag,
 		}
 		if (AllMust) {
 			IntFlag = Must_Return_Err;
-			//markEdgesToErrReturn(TB, IntFlag, edgeErrMap);
-			for (BasicBlock *predBB : predecessors(TB)) {
-				Instruction *TI = predBB->getTerminator();	
-				CFGEdge CE = std::make_pair(TI, TB);
-				if (!(edgeErrMap[CE] & IntFlag)) {
-					updateReturnFlag(edgeErrMap[CE], IntFlag);
-					EEP.push_back(std::make_pair(CE, IntFlag));
+			for (uint32_t PredE : CFG.predEdgeIDs(TB)) {
+				if (!(edgeErrMap[PredE] & IntFlag)) {
+					updateReturnFlag(edgeErrMap[PredE], IntFlag);
+					EEP.push_back(std::make_pair(PredE, IntFlag));
 				}
 			}
 		}
 		else if (!AllZero && !AllMust) {
-			recurMarkEdgesToErrReturn(TB, May_Return_Err, edgeErrMap);
+			recurMarkEdgesToErrReturn(CFG, TB, May_Return_Err, edgeErrMap, WS);
 			continue;
 		}
 		else {
@@ -390,214 +381,313 @@ void SecurityChecksPass::recurMarkEdgesToBlock(CFGEdge &CE, int flag,
 			continue;
 		}
 	}
+	WS.clearEdges();
 }
 
 /// Recursively mark edges from the error-handling block to the
 /// closest branches
-void SecurityChecksPass::recurMarkEdgesToErrHandle(BasicBlock *BB, 
-		EdgeErrMap &edgeErrMap) {
+void SecurityChecksPass::recurMarkEdgesToErrHandle(const CFGOverlay &CFG,
+		BasicBlock *BB, EdgeErrMap &edgeErrMap, MarkWalkState &WS) {
 	// Invalid input.
 	if (!BB)
 		return;
 
-	std::set<BasicBlock *> PB;
-	std::list<BasicBlock *> EB;
-	PB.clear();
-	EB.clear();
+	vector<char> &PB = WS.VisitedBlocks;
+	vector<uint32_t> &EB = WS.BlockWork;
+	size_t Head = 0;
 
-	EB.push_back(BB);
-	while (!EB.empty()) {
+	EB.push_back(CFG.getBlockID(BB));
+	while (Head < EB.size()) {
 
-		BasicBlock *TB = EB.front();
-		EB.pop_front();
-		if (PB.count(TB) != 0)
+		uint32_t TB = EB[Head++];
+		if (PB[TB])
 			continue;
-		PB.insert(TB);
+		PB[TB] = 1;
 		// Iterate on each predecessor basic block.
-		for (BasicBlock *predBB : predecessors(TB)) {
-			Instruction *TI = predBB->getTerminator();	
-			CFGEdge CE = std::make_pair(TI, TB);
+		for (uint32_t PredE : CFG.predEdgeIDs(CFG.getBlock(TB))) {
 			int NewHandleFlag = Must_Handle_Err;
-			if (edgeErrMap[CE] & NewHandleFlag)
+			if (edgeErrMap[PredE] & NewHandleFlag)
 				continue;
-			updateHandleFlag(edgeErrMap[CE], NewHandleFlag);
+			updateHandleFlag(edgeErrMap[PredE], NewHandleFlag);
 			// reaches a branch, stop
-			if (TI->getNumSuccessors() > 1)
+			uint32_t PredB = CFG.getEdgeSrc(PredE);
+			if (CFG.getBlock(PredB)->getTerminator()->getNumSuccessors() > 1)
 				continue;
-			EB.push_back(predBB);
+			EB.push_back(PredB);
 		}
 	}
+	WS.clearBlocks();
 }
 
 /// Recursively mark edges to the error-returning block
-void SecurityChecksPass::recurMarkEdgesToErrReturn(BasicBlock *BB, 
-		int flag, EdgeErrMap &edgeErrMap) {
+void SecurityChecksPass::recurMarkEdgesToErrReturn(const CFGOverlay &CFG,
+		BasicBlock *BB, int flag, EdgeErrMap &edgeErrMap, MarkWalkState &WS) {
 
 	if (!BB)
 		return;
 
-	std::set<BasicBlock *> PB;
-	std::list<BasicBlock *> EB;
-	PB.clear();
-	EB.clear();
+	vector<char> &PB = WS.VisitedBlocks;
+	vector<uint32_t> &EB = WS.BlockWork;
+	size_t Head = 0;
 
-	EB.push_back(BB);
-	while (!EB.empty()) {
+	EB.push_back(CFG.getBlockID(BB));
+	while (Head < EB.size()) {
 
-		BasicBlock *TB = EB.front();
-		EB.pop_front();
-		if (PB.count(TB) != 0)
+		uint32_t TB = EB[Head++];
+		if (PB[TB])
 			continue;
-		PB.insert(TB);
+		PB[TB] = 1;
 		// Iterate on each predecessor basic block.
-		for (BasicBlock *predBB : predecessors(TB)) {
-			Instruction *TI = predBB->getTerminator();	
-			CFGEdge CE = std::make_pair(TI, TB);
-			if ((edgeErrMap[CE] & ERR_RETURN_MASK) ==
+		for (uint32_t PredE : CFG.predEdgeIDs(CFG.getBlock(TB))) {
+			if ((edgeErrMap[PredE] & ERR_RETURN_MASK) ==
 					(flag & ERR_RETURN_MASK))
 				continue;
-			updateReturnFlag(edgeErrMap[CE], flag);
-			EB.push_back(predBB);
+			updateReturnFlag(edgeErrMap[PredE], flag);
+			EB.push_back(CFG.getEdgeSrc(PredE));
 		}
 	}
+	WS.clearBlocks();
 }
 
 /// Mark direct edges to the error-returning block
-void SecurityChecksPass::markEdgesToErrReturn(BasicBlock *BB, 
-		int flag, EdgeErrMap &edgeErrMap) {
+void SecurityChecksPass::markEdgesToErrReturn(const CFGOverlay &CFG,
+		BasicBlock *BB, int flag, EdgeErrMap &edgeErrMap) {
 
 	// Iterate on each predecessor basic block.
-	for (BasicBlock *predBB : predecessors(BB)) {
-		Instruction *TI = predBB->getTerminator();	
-		CFGEdge CE = std::make_pair(TI, BB);
-		if ((edgeErrMap[CE] & ERR_RETURN_MASK) 
+	for (uint32_t PredE : CFG.predEdgeIDs(BB)) {
+		if ((edgeErrMap[PredE] & ERR_RETURN_MASK) 
 				== (flag & ERR_RETURN_MASK))
 			continue;
-		updateReturnFlag(edgeErrMap[CE], flag);
+		updateReturnFlag(edgeErrMap[PredE], flag);
 	}
 }
 
-/// Traverse the CFG to mark all edges with an error flag
+/// Traverse the CFG to mark all edges with an error flag, by walks
+/// from each error-related block
 bool SecurityChecksPass::markAllEdgesErrFlag(Function *F, BBErrMap &bbErrMap, 
 		EdgeErrMap &edgeErrMap) {
 
-	if (bbErrMap.size() == 0)
-		return false;
+	const CFGOverlay &CFG = Ctx->getCFGOverlay(F);
+	MarkWalkState WS(CFG);
 
 	// Recursively mark flags
-	for (Function::iterator b = F->begin(), e = F->end();
-			b != e; ++b) {
-
-		BasicBlock *BB = &*b;
+	bool Marked = false;
+	for (uint32_t B = 0; B < CFG.getNumBlocks(); ++B) {
 
 		// No error-related operations
-		if (bbErrMap.count(BB) == 0)
+		int NewFlag = bbErrMap[B];
+		if (!NewFlag)
 			continue;
+		Marked = true;
 
 		// Upon error-related operations, update edges
-		int NewFlag = bbErrMap[BB];
+		BasicBlock *BB = CFG.getBlock(B);
 		// The only marking for error-handling cases
 		if (NewFlag & Must_Handle_Err) {
-			recurMarkEdgesToErrHandle(BB, edgeErrMap);
+			recurMarkEdgesToErrHandle(CFG, BB, edgeErrMap, WS);
 		}
 
 		// Marking error-returning cases
 		if ((NewFlag & ERR_RETURN_MASK)) {
 			// First update all edges to the block
 			// mark all predecessor edges with the flag
-			for (BasicBlock *Pred : predecessors(BB)) {
-				CFGEdge CE = std::make_pair(Pred->getTerminator(), BB);
-				updateReturnFlag(edgeErrMap[CE], NewFlag);
-				recurMarkEdgesToBlock(CE, NewFlag, bbErrMap, edgeErrMap);
+			for (uint32_t PredE : CFG.predEdgeIDs(BB)) {
+				updateReturnFlag(edgeErrMap[PredE], NewFlag);
+				recurMarkEdgesToBlock(CFG, PredE, NewFlag, bbErrMap, edgeErrMap,
+						WS);
 			}
 			// Then update all edges from the block
-			for (BasicBlock *Succ : successors(BB)) {
-				CFGEdge CE = std::make_pair(BB->getTerminator(), Succ);
-				updateReturnFlag(edgeErrMap[CE], NewFlag);
-				recurMarkEdgesFromBlock(CE, NewFlag, bbErrMap, edgeErrMap);
+			for (uint32_t SuccE : CFG.succEdgeIDs(BB)) {
+				updateReturnFlag(edgeErrMap[SuccE], NewFlag);
+				recurMarkEdgesFromBlock(CFG, SuccE, NewFlag, bbErrMap, edgeErrMap,
+						WS);
 			}
 		}
 	}
 
-	return true;
+	return Marked;
 }
 
-/// Efficiently but inprecisely check if the function may return an
-/// error
-bool SecurityChecksPass::mayReturnErr(Function *F) {
+/// Efficiently but inprecisely check if the function itself may
+/// return an error, and collect the functions whose errors it may
+/// return
+bool SecurityChecksPass::localMayReturnErr(Function *F,
+		SmallVectorImpl<Function *> &Callees) {
 
-	std::set<Function *> PF;
-	std::list<Function *> EF;
+	if (F->empty())
+		return false;
 
-	PF.clear();
-	EF.clear();
+	for (Function::iterator b = F->begin(), e = F->end();
+			b != e; ++b) {
+		BasicBlock *BB = &*b;
+		for (BasicBlock::iterator I = BB->begin(),
+				IE = BB->end(); I != IE; ++I) {
+			StoreInst *SI = dyn_cast<StoreInst>(&*I);
+			if (SI) {
+				Value *SV = SI->getValueOperand();
+				if (isValueErrno(SV, F)) {
+					return true;
+				}
+				continue;
+			}
+			CallInst *CI = dyn_cast<CallInst>(&*I);
+			if (CI) {
+				Type * Ty= CI->getType();
+				if (Ty->isPointerTy())
+					return true;
+				Function *CF = CI->getCalledFunction();
+				if (!CF)
+					continue;
+				StringRef FName = getCalledFuncName(CI);
+				if (FName == "ERR_PTR" || FName == "PTR_ERR")
+					return true;
+				// Get the actual called function
+				CF = Ctx->CallGraph.getResolvedCallee(CI);
+				if (CF)
+					Callees.push_back(CF);
+
+				continue;
+			}
+			ReturnInst *RI = dyn_cast<ReturnInst>(&*I);
+			if (RI) {
+				Value *RV = RI->getReturnValue();
+				if (!RV)
+					continue;
+				if (CallInst *RCI = dyn_cast<CallInst>(RV)) {
+					Function *RF = Ctx->CallGraph.getResolvedCallee(RCI);
+					if (RF)
+						Callees.push_back(RF);
+				}
+				continue;
+			}
+		}
+	}
+	return false;
+}
+
+// Check if the function may return an error by walking the functions
+// it reaches through localMayReturnErr(). With UseSummaries, the
+// walk stops at functions with a summary and takes their result;
+// otherwise, the summaries are checked against it with
+// VERIFY_ERR_SUMMARIES.
+bool SecurityChecksPass::walkMayReturnErr(Function *F, bool UseSummaries) {
+
+	SmallPtrSet<Function *, 16> PF;
+	SmallVector<Function *, 16> EF;
 	EF.push_back(F);
 
 	while (!EF.empty()) {
 
-		Function *TF = EF.front();
-		EF.pop_front();
-
-		if (PF.count(TF) != 0)
+		Function *TF = EF.pop_back_val();
+		if (!PF.insert(TF).second)
 			continue;
-		PF.insert(TF);
 
-		if (TF->empty())
-			continue;
+		if (UseSummaries) {
+			auto it = MayReturnErrMap.find(TF);
+			if (it != MayReturnErrMap.end()) {
+				if (it->second)
+					return true;
+				continue;
+			}
+		}
 
-		for (Function::iterator b = TF->begin(), e = TF->end();
-				b != e; ++b) {
-			BasicBlock *BB = &*b;
-			for (BasicBlock::iterator I = BB->begin(),
-					IE = BB->end(); I != IE; ++I) {
-				StoreInst *SI = dyn_cast<StoreInst>(&*I);
-				if (SI) {
-					Value *SV = SI->getValueOperand();
-					if (isValueErrno(SV, TF)) {
-						return true;
-					}
-					continue;
-				}
-				CallInst *CI = dyn_cast<CallInst>(&*I);
-				if (CI) {
-					Type * Ty= CI->getType();
-					if (Ty->isPointerTy())
-						return true;
-					Function *CF = CI->getCalledFunction();
-					if (!CF)
-						continue;
-					StringRef FName = getCalledFuncName(CI);
-					if (FName == "ERR_PTR" || FName == "PTR_ERR")
-						return true;
-					// Get the actual called function
-					if (Ctx->Callees[CI].size() == 0)
-						continue;
-					CF = *(Ctx->Callees[CI].begin());
-					if (CF) {
-						EF.push_back(CF);
-						continue;
-					}
+		SmallVector<Function *, 4> Callees;
+		if (localMayReturnErr(TF, Callees))
+			return true;
+		EF.append(Callees.begin(), Callees.end());
+	}
+	return false;
+}
 
-					continue;
-				}
-				ReturnInst *RI = dyn_cast<ReturnInst>(&*I);
-				if (RI) {
-					Value *RV = RI->getReturnValue();
-					if (!RV)
-						continue;
-					if (CallInst *RCI = dyn_cast<CallInst>(RV)) {
-						if (Ctx->Callees[RCI].size() == 0)
-							continue;
-						Function *RF = *(Ctx->Callees[RCI].begin());
-						if (RF)
-							EF.push_back(RF);
-					}
-					continue;
-				}
+// Compute mayReturnErr() for all functions at once. A function may
+// return an error if it or any function it reaches through
+// localMayReturnErr() may, so the result is shared by an SCC of that
+// relation. The local checks run in parallel; SCCs are then merged
+// bottom-up.
+void SecurityChecksPass::buildErrReturnSummaries() {
+
+	vector<Function *> Funcs(Ctx->UnifiedFuncSet.begin(),
+			Ctx->UnifiedFuncSet.end());
+	DenseMap<Function *, uint32_t> FuncIdx;
+	for (uint32_t i = 0; i < Funcs.size(); ++i)
+		FuncIdx[Funcs[i]] = i;
+
+	// The local checks run in rounds: callees that are not unified
+	// functions, e.g., other copies of address-taken functions, are
+	// checked in the next round, so that every function of the
+	// relation has its own result
+	vector<SmallVector<Function *, 4>> Callees;
+	vector<char> Local;
+	unsigned NumThreads = getNumThreads();
+	size_t Begin = 0;
+	while (Begin < Funcs.size()) {
+		size_t End = Funcs.size();
+		Callees.resize(End);
+		Local.resize(End, 0);
+		parallelFor(End - Begin, NumThreads, [&](size_t i, unsigned t) {
+			Local[Begin + i] = localMayReturnErr(Funcs[Begin + i],
+					Callees[Begin + i]);
+		});
+		for (size_t i = Begin; i < End; ++i) {
+			for (Function *CF : Callees[i]) {
+				if (FuncIdx.insert(make_pair(CF, (uint32_t)Funcs.size())).second)
+					Funcs.push_back(CF);
 			}
 		}
+		Begin = End;
 	}
-	return false;
+
+	CallGraphSCC SCCs;
+	SCCs.build(Funcs, [&](Function *F, SmallVectorImpl<Function *> &CFs) {
+		auto it = FuncIdx.find(F);
+		if (it != FuncIdx.end())
+			CFs.append(Callees[it->second].begin(),
+					Callees[it->second].end());
+	});
+
+	vector<char> SCCMayReturnErr(SCCs.size(), 0);
+	SCCs.runBottomUp(NumThreads, [&](uint32_t S) {
+		bool May = false;
+		for (uint32_t T : SCCs.getCalleeSCCs(S))
+			May |= SCCMayReturnErr[T];
+		for (Function *F : SCCs.getSCC(S)) {
+			auto it = FuncIdx.find(F);
+			if (it != FuncIdx.end())
+				May |= Local[it->second];
+		}
+		SCCMayReturnErr[S] = May;
+	});
+
+	for (uint32_t S = 0; S < SCCs.size(); ++S)
+		for (Function *F : SCCs.getSCC(S))
+			MayReturnErrMap[F] = SCCMayReturnErr[S];
+	ErrSummariesBuilt = true;
+
+#ifdef VERIFY_ERR_SUMMARIES
+	for (Function *F : Funcs) {
+		if (walkMayReturnErr(F, false) != MayReturnErrMap[F])
+			OP << "== Mismatched mayReturnErr summary of "
+				<< F->getName() << "\n";
+	}
+#endif
+}
+
+bool SecurityChecksPass::mayReturnErr(Function *F) {
+
+	if (!ErrSummariesBuilt)
+		buildErrReturnSummaries();
+
+	auto it = MayReturnErrMap.find(F);
+	if (it != MayReturnErrMap.end())
+		return it->second;
+
+	// Not reached from the unified functions, e.g., only called
+	// indirectly: walk the functions it reaches down to those with a
+	// summary. The result is complete, so it is kept as well. Queries
+	// come from the pass thread only, so the map is not locked.
+	bool May = walkMayReturnErr(F, true);
+	MayReturnErrMap[F] = May;
+	return May;
 }
 
 /// Check if the returned value must be or may be an errno.
@@ -624,6 +714,20 @@ void SecurityChecksPass::checkErrReturn(Function *F,
 	return;
 }
 
+/// Check if the *printk call logs an error, i.e., at KERN_WARNING
+/// or a more severe level, like pr_err() and pr_warn()
+bool SecurityChecksPass::isErrPrintk(CallInst *CI) {
+
+	auto it = ErrPrintkMap.find(CI);
+	if (it != ErrPrintkMap.end())
+		return it->second;
+
+	int Level = getPrintkLevel(CI);
+	bool IsErr = Level >= 0 && Level <= ERR_PRINTK_LEVEL;
+	ErrPrintkMap[CI] = IsErr;
+	return IsErr;
+}
+
 /// Find error handling code
 void SecurityChecksPass::checkErrHandle(Function *F, 
 		BBErrMap &bbErrMap) {
@@ -637,20 +741,27 @@ void SecurityChecksPass::checkErrHandle(Function *F,
 			if (CI) {
 				StringRef FuncName = getCalledFuncName(CI);
 
-				// For inline assembly code, just take the first substring
-				// without a space
-				if(FuncName.find(' ') != std::string::npos)
-					FuncName = FuncName.substr(0, FuncName.find(' '));
+				if (CI->isInlineAsm()) {
+					// For inline assembly code, just take the first
+					// substring without a space
+					if(FuncName.find(' ') != std::string::npos)
+						FuncName = FuncName.substr(0, FuncName.find(' '));
 
-				string funcName = FuncName.str();
-				if (FuncName.endswith("printk")) 
-					funcName = getSourceFuncName(CI);
-
-				auto FIter = Ctx->ErrorHandleFuncs.find(funcName);
-				// The called function handles an error, so mark the edge
-				if (FIter != Ctx->ErrorHandleFuncs.end()) {
-					markBBErr(BB, Must_Handle_Err, bbErrMap);
-					continue;
+					auto FIter = Ctx->ErrorHandleFuncs.find(FuncName.str());
+					if (FIter != Ctx->ErrorHandleFuncs.end()) {
+						markBBErr(BB, Must_Handle_Err, bbErrMap);
+						continue;
+					}
+				}
+				else if (FuncRoles *FR = Ctx->getCalleeRoles(CI)) {
+					bool IsErrHandle = FR->Mask & FR_ErrHandle;
+					if (!IsErrHandle && (FR->Mask & FR_Printk))
+						IsErrHandle = isErrPrintk(CI);
+					// The called function handles an error, so mark the edge
+					if (IsErrHandle) {
+						markBBErr(BB, Must_Handle_Err, bbErrMap);
+						continue;
+					}
 				}
 
 				// Detect BUG, BUG_ON, WARN_ON more precisely
@@ -681,9 +792,11 @@ void SecurityChecksPass::identifySecurityChecks(Function *F,
 		EdgeErrMap &edgeErrMap,
 		set<SecurityCheck *> &SCSet) {
 
-	BBErrMap bbErrMap;
+	const CFGOverlay &CFG = Ctx->getCFGOverlay(F);
 
-	edgeErrMap.clear();
+	BBErrMap bbErrMap(CFG.getNumBlocks(), 0);
+
+	edgeErrMap.assign(CFG.getNumEdges(), 0);
 	SCSet.clear();
 
 #ifdef TEST_CASE
@@ -703,7 +816,7 @@ void SecurityChecksPass::identifySecurityChecks(Function *F,
 	// Find and record basic blocks that have error handling code
 	checkErrHandle(F, bbErrMap);
 
-	if (bbErrMap.size() > 0) {
+	if (llvm::any_of(bbErrMap, [](int Flag) { return Flag != 0; })) {
 #ifdef DEBUG_PRINT
 		OP << "\n\033[32m" << F->getName() << 
 			"\033[0m may return or handle an error" << '\n';
@@ -714,16 +827,15 @@ void SecurityChecksPass::identifySecurityChecks(Function *F,
 	// on this edge. The index is the edge, i.e., the terminator instruction and
 	// the index of the successor of the terminator instruction. This data structure
 	// may need to be promoted to SecurityChecksPass.
-	markAllEdgesErrFlag(F, bbErrMap, edgeErrMap);
+	bool Marked = markAllEdgesErrFlag(F, bbErrMap, edgeErrMap);
 
 #ifdef DEBUG_PRINT
-	dumpErrEdges(edgeErrMap);
+	dumpErrEdges(CFG, edgeErrMap);
 #endif
 
 
 	// Filtering
-	if (edgeErrMap.size() == 0 	&& 
-			ErrSelectInstSet.size() == 0)
+	if (!Marked && ErrSelectInstSet.size() == 0)
 		return;
 
 	//
@@ -758,8 +870,8 @@ void SecurityChecksPass::identifySecurityChecks(Function *F,
 			int errFlag = 0; 
 			int NumMayErrReturn = 0, NumMustErrReturn = 0;
 			int NumMayErrHandle = 0, NumMustErrHandle = 0;
-			for (BasicBlock *Succ : successors(BB)) {
-				errFlag = edgeErrMap[std::make_pair(Inst, Succ)];
+			for (uint32_t SuccE : CFG.succEdgeIDs(BB)) {
+				errFlag = edgeErrMap[SuccE];
 				if (errFlag & Must_Return_Err)
 					++NumMustErrReturn;
 				else 
@@ -838,23 +950,20 @@ void SecurityChecksPass::checkErrValueFlow(
 		if (auto LI = dyn_cast<LoadInst>(V)) {
 
 			Value *LPO = LI->getPointerOperand();
-			for (User *U : LPO->users()) {
-				if (LI == U)
-					continue;
-				StoreInst *SI = dyn_cast<StoreInst>(U);
-				if (SI && LPO == SI->getPointerOperand()) {
-					Value *SVO = SI->getValueOperand();
-					if (isConstant(SVO)) {
-						if (isValueErrno(SVO, F))
-							markBBErr(SI->getParent(), Must_Return_Err, bbErrMap);
-						else 
-							// Maybe mark as Not_Return_Err
-							markBBErr(SI->getParent(), May_Return_Err, bbErrMap);
-					} 
-					else { 
-						CFGEdge	NE = make_pair(SI->getParent()->getTerminator(), BB);
-						EEV.push_back(make_pair(NE, SVO));
-					}
+			SmallVector<StoreInst *, 8> Stores;
+			Ctx->getMemoryDefUse(F).getReachingStores(LI, LPO, Stores);
+			for (StoreInst *SI : Stores) {
+				Value *SVO = SI->getValueOperand();
+				if (isConstant(SVO)) {
+					if (isValueErrno(SVO, F))
+						markBBErr(SI->getParent(), Must_Return_Err, bbErrMap);
+					else 
+						// Maybe mark as Not_Return_Err
+						markBBErr(SI->getParent(), May_Return_Err, bbErrMap);
+				} 
+				else { 
+					CFGEdge	NE = make_pair(SI->getParent()->getTerminator(), BB);
+					EEV.push_back(make_pair(NE, SVO));
 				}
 			}
 			continue;
@@ -954,11 +1063,11 @@ void SecurityChecksPass::checkErrValueFlow(
 				continue;
 			}
 #endif
-			auto FIter = Ctx->CopyFuncs.find(FName.str());
-			if (FIter != Ctx->CopyFuncs.end()) {
-				if (get<1>(FIter->second) == -1) {
+			FuncRoles *FR = Ctx->getCalleeRoles(CaI);
+			if (FR && (FR->Mask & FR_Copy)) {
+				if (FR->CopyDst == -1) {
 					Value *Arg = 
-						CaI->getArgOperand(get<0>(FIter->second));
+						CaI->getArgOperand(FR->CopySrc);
 					if (isValueErrno(Arg, F)) {
 						markBBErr(CaI->getParent(), Must_Return_Err, bbErrMap);
 						continue;
@@ -971,9 +1080,7 @@ void SecurityChecksPass::checkErrValueFlow(
 				}
 			}
 			// Get the actual called function
-			if (Ctx->Callees[CaI].size() == 0)
-				continue;
-			CF = *(Ctx->Callees[CaI].begin());
+			CF = Ctx->CallGraph.getResolvedCallee(CaI);
 			if (!CF)
 				continue;
 			if (mayReturnErr(CF)) {
@@ -1168,5 +1275,8 @@ bool SecurityChecksPass::doModulePass(Module *M) {
 
 	} // End function iteration
 
+	// Free the def-use of memory of the functions
+	Ctx->releaseFuncAnalyses();
+
 	return false;
 }
@@ -28,16 +28,19 @@ class SecurityChecksPass : public IterativeModulePass {
 
 	public:
 
-	typedef std::map<CFGEdge, int> EdgeErrMap;
-	typedef std::map<BasicBlock *, int> BBErrMap;
+	// Error flags of the edges and the blocks of a function, indexed
+	// by their IDs in the CFG overlay of the function
+	typedef std::vector<int> EdgeErrMap;
+	typedef std::vector<int> BBErrMap;
 
 	static set<Instruction *>ErrSelectInstSet;
 
 	private:
 
 	// Dump marked edges.
-	void dumpErrEdges(EdgeErrMap &edgeErrMap);
+	void dumpErrEdges(const CFGOverlay &CFG, EdgeErrMap &edgeErrMap);
 	bool isValueErrno(Value *V, Function *F);
+	bool isConstErrno(Constant *C, bool RetPtr);
 
 	///
 	/// Identifying sanity checks
@@ -48,12 +51,26 @@ class SecurityChecksPass : public IterativeModulePass {
 	// Find and record blocks with error handling 
 	void checkErrHandle(Function *F, BBErrMap &bbErrMap);
 
+	// Check if a *printk call logs an error, from its format string
+	bool isErrPrintk(CallInst *CI);
+	static DenseMap<CallInst *, bool>ErrPrintkMap;
+
 	// Mark the given block with an error flag.
 	void markBBErr(BasicBlock *BB, ErrFlag flag, BBErrMap &bbErrMap);
 
 	// A lighweiht and inprecise way to check if the function may
 	// return an error
 	bool mayReturnErr(Function *F);
+	bool localMayReturnErr(Function *F, SmallVectorImpl<Function *> &Callees);
+	void buildErrReturnSummaries();
+	bool walkMayReturnErr(Function *F, bool UseSummaries);
+
+	// Results of mayReturnErr(), computed once for all functions.
+	// Only accessed from the pass thread: the parallel local checks
+	// of buildErrReturnSummaries() write their own vectors, and the
+	// map is filled after them.
+	static DenseMap<Function *, bool>MayReturnErrMap;
+	static bool ErrSummariesBuilt;
 
 	// Collect all blocks that influence the return value
 	void checkErrValueFlow(Function *F, ReturnInst *RI, 
@@ -62,23 +79,54 @@ class SecurityChecksPass : public IterativeModulePass {
 	// Traverse CFG to mark all edges with error flags
 	bool markAllEdgesErrFlag(Function *F, BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap);
 
+	// Visited flags and worklists of the marking walks, allocated
+	// once per function. Each walk clears the flags it set, so that
+	// a walk costs what it visits.
+	struct MarkWalkState {
+		vector<char> VisitedEdges;
+		vector<std::pair<uint32_t, int>> EdgeWork;
+		vector<char> VisitedBlocks;
+		vector<uint32_t> BlockWork;
+
+		MarkWalkState(const CFGOverlay &CFG)
+			: VisitedEdges(CFG.getNumEdges(), 0),
+			VisitedBlocks(CFG.getNumBlocks(), 0) { }
+
+		// Every visited edge or block is on the worklist
+		void clearEdges() {
+			for (auto &EP : EdgeWork)
+				VisitedEdges[EP.first] = 0;
+			EdgeWork.clear();
+		}
+		void clearBlocks() {
+			for (uint32_t B : BlockWork)
+				VisitedBlocks[B] = 0;
+			BlockWork.clear();
+		}
+	};
+
 	// Recursively mark all edges from the given block
-	void recurMarkEdgesFromBlock(CFGEdge &CE, int flag, 
-			BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap);
+	void recurMarkEdgesFromBlock(const CFGOverlay &CFG, uint32_t CE,
+			int flag, BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap,
+			MarkWalkState &WS);
 
 	// Recursively mark all edges to the given block
-	void recurMarkEdgesToBlock(CFGEdge &CE, int flag, 
-			BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap);
+	void recurMarkEdgesToBlock(const CFGOverlay &CFG, uint32_t CE,
+			int flag, BBErrMap &bbErrMap, EdgeErrMap &edgeErrMap,
+			MarkWalkState &WS);
 
 	// Recursively mark edges from the error-handling block to the
 	// closest branches
-	void recurMarkEdgesToErrHandle(BasicBlock *BB, EdgeErrMap &edgeErrMap);
+	void recurMarkEdgesToErrHandle(const CFGOverlay &CFG, BasicBlock *BB,
+			EdgeErrMap &edgeErrMap, MarkWalkState &WS);
 
 	// Recursively mark edges to the error-returning block
-	void recurMarkEdgesToErrReturn(BasicBlock *BB, int flag, EdgeErrMap &edgeErrMap);
+	void recurMarkEdgesToErrReturn(const CFGOverlay &CFG, BasicBlock *BB,
+			int flag, EdgeErrMap &edgeErrMap, MarkWalkState &WS);
 
 	// Mark direct edges to the error-returning block
-	void markEdgesToErrReturn(BasicBlock *BB, int flag, EdgeErrMap &edgeErrMap);
+	void markEdgesToErrReturn(const CFGOverlay &CFG, BasicBlock *BB,
+			int flag, EdgeErrMap &edgeErrMap);
 
 	// Add identified checks to the set
 	void addSecurityCheck(Value *, Value *, std::set<SecurityCheck *> &);
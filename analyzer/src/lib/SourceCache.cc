@@ -0,0 +1,65 @@
+//===-- SourceCache.cc - Cached lines of source files------------===//
+//
+// This file maps source files into memory and indexes their lines,
+// so that printing a report reads each file once instead of
+// scanning it from the top for every line.
+//
+//===-----------------------------------------------------------===//
+
+#include <cstring>
+
+#include "SourceCache.h"
+
+unique_ptr<SourceCache::SourceFile> SourceCache::loadFile(
+		StringRef FileName) {
+
+	unique_ptr<SourceFile> SF = make_unique<SourceFile>();
+
+	// Without a null terminator, the file is mapped unless it is small
+	auto BufOrErr = MemoryBuffer::getFile(FileName, -1,
+			/*RequiresNullTerminator=*/false);
+	if (!BufOrErr)
+		return SF;
+	SF->Buffer = std::move(*BufOrErr);
+
+	const char *Begin = SF->Buffer->getBufferStart();
+	size_t Size = SF->Buffer->getBufferSize();
+	SF->LineOffsets.push_back(0);
+	for (const char *P = Begin, *End = Begin + Size; P < End; ++P) {
+		P = static_cast<const char *>(memchr(P, '\n', End - P));
+		if (!P)
+			break;
+		SF->LineOffsets.push_back(P - Begin + 1);
+	}
+	// The last line has no line break
+	if (SF->LineOffsets.back() != Size)
+		SF->LineOffsets.push_back(Size);
+
+	return SF;
+}
+
+StringRef SourceCache::getLine(StringRef FileName, unsigned LineNo) {
+
+	SourceFile *SF;
+	{
+		lock_guard<mutex> Lock(FilesMutex);
+		unique_ptr<SourceFile> &SFP = Files[FileName];
+		if (!SFP)
+			SFP = loadFile(FileName);
+		SF = SFP.get();
+	}
+
+	if (!SF->Buffer || LineNo == 0 || LineNo >= SF->LineOffsets.size())
+		return "";
+
+	size_t Begin = SF->LineOffsets[LineNo - 1];
+	size_t End = SF->LineOffsets[LineNo];
+	StringRef Line = SF->Buffer->getBuffer().slice(Begin, End);
+	return Line.rtrim("\r\n");
+}
+
+SourceCache &getSourceCache() {
+
+	static SourceCache Cache;
+	return Cache;
+}
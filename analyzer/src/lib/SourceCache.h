@@ -0,0 +1,44 @@
+#ifndef SOURCE_CACHE_H
+#define SOURCE_CACHE_H
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+//
+// Lines of source files for printing reports. Each file is mapped
+// into memory and indexed by the offsets of its lines on the first
+// query; lines are returned as references into the mapping, which
+// lives as long as the cache.
+//
+class SourceCache {
+
+	public:
+		// Line LineNo (from 1) of the file without the line break, or
+		// an empty line if the file or the line does not exist
+		StringRef getLine(StringRef FileName, unsigned LineNo);
+
+	private:
+		struct SourceFile {
+			// NULL if the file cannot be read
+			unique_ptr<MemoryBuffer> Buffer;
+			// Line i (from 1) is [LineOffsets[i - 1], LineOffsets[i])
+			vector<size_t> LineOffsets;
+		};
+
+		StringMap<unique_ptr<SourceFile>> Files;
+		mutex FilesMutex;
+
+		unique_ptr<SourceFile> loadFile(StringRef FileName);
+};
+
+// The source cache shared by all analyses
+SourceCache &getSourceCache();
+
+#endif
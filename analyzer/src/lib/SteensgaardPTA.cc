@@ -0,0 +1,450 @@
+//===-- SteensgaardPTA.cc - Unification-based points-to---------===//
+//
+// This file collects the points-to constraints of all modules and
+// solves them by unification. Each instruction is visited once; the
+// unifications it implies, e.g., of the slots of two merged objects,
+// are propagated through a worklist of cell pairs.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+
+#include "SteensgaardPTA.h"
+#include "Analyzer.h"
+#include "Config.h"
+
+uint32_t SteensgaardPTA::newCell() {
+
+	uint32_t C = CellParents.size();
+	CellParents.push_back(C);
+	CellLocs.push_back({NoObj, 0});
+	return C;
+}
+
+uint32_t SteensgaardPTA::newObj() {
+
+	uint32_t O = ObjParents.size();
+	ObjParents.push_back(O);
+	ObjFields.emplace_back();
+	ObjCollapsed.push_back(0);
+	return O;
+}
+
+uint32_t SteensgaardPTA::findCell(uint32_t C) {
+
+	while (CellParents[C] != C) {
+		CellParents[C] = CellParents[CellParents[C]];
+		C = CellParents[C];
+	}
+	return C;
+}
+
+uint32_t SteensgaardPTA::findObj(uint32_t O) {
+
+	while (ObjParents[O] != O) {
+		ObjParents[O] = ObjParents[ObjParents[O]];
+		O = ObjParents[O];
+	}
+	return O;
+}
+
+SteensgaardPTA::Loc SteensgaardPTA::canonical(Loc L) {
+
+	if (L.Obj == NoObj)
+		return L;
+	uint32_t O = findObj(L.Obj);
+	return {O, ObjCollapsed[O] ? 0 : L.Off};
+}
+
+SteensgaardPTA::Loc SteensgaardPTA::getPointee(uint32_t C) {
+
+	C = findCell(C);
+	if (CellLocs[C].Obj == NoObj)
+		CellLocs[C] = {newObj(), 0};
+	return canonical(CellLocs[C]);
+}
+
+uint32_t SteensgaardPTA::getSlot(Loc L) {
+
+	L = canonical(L);
+	auto it = ObjFields[L.Obj].find(L.Off);
+	if (it != ObjFields[L.Obj].end())
+		return it->second;
+	uint32_t C = newCell();
+	ObjFields[L.Obj][L.Off] = C;
+	return C;
+}
+
+// Merge all slots of the object into the one at offset 0
+void SteensgaardPTA::collapse(uint32_t O) {
+
+	if (ObjCollapsed[O])
+		return;
+	ObjCollapsed[O] = 1;
+	if (ObjFields[O].empty())
+		return;
+
+	uint32_t First = ObjFields[O].begin()->second;
+	for (auto &Field : ObjFields[O])
+		Pending.push_back(make_pair(First, Field.second));
+	ObjFields[O].clear();
+	ObjFields[O][0] = First;
+}
+
+// Merge the object classes A and B (roots); slots at the same offset
+// are unified
+void SteensgaardPTA::mergeObjs(uint32_t A, uint32_t B) {
+
+	if (A == B)
+		return;
+	if (ObjCollapsed[A] != ObjCollapsed[B]) {
+		collapse(A);
+		collapse(B);
+	}
+	if (ObjFields[A].size() < ObjFields[B].size())
+		std::swap(A, B);
+
+	ObjParents[B] = A;
+	DenseMap<int64_t, uint32_t> Fields;
+	Fields.swap(ObjFields[B]);
+	for (auto &Field : Fields) {
+		auto ins = ObjFields[A].insert(Field);
+		if (!ins.second)
+			Pending.push_back(make_pair(ins.first->second, Field.second));
+	}
+}
+
+// Unify two locations. Locations at different offsets can only be
+// the same if the objects are collapsed.
+void SteensgaardPTA::unifyLocs(Loc A, Loc B) {
+
+	A = canonical(A);
+	B = canonical(B);
+	if (A.Obj == B.Obj && A.Off == B.Off)
+		return;
+
+	if (A.Off != B.Off) {
+		collapse(A.Obj);
+		collapse(B.Obj);
+	}
+	mergeObjs(A.Obj, B.Obj);
+}
+
+void SteensgaardPTA::drain() {
+
+	while (!Pending.empty()) {
+		uint32_t A = findCell(Pending.back().first);
+		uint32_t B = findCell(Pending.back().second);
+		Pending.pop_back();
+		if (A == B)
+			continue;
+
+		CellParents[B] = A;
+		Loc LA = CellLocs[A], LB = CellLocs[B];
+		if (LA.Obj == NoObj)
+			CellLocs[A] = LB;
+		else if (LB.Obj != NoObj)
+			unifyLocs(LA, LB);
+	}
+}
+
+void SteensgaardPTA::unifyCells(uint32_t A, uint32_t B) {
+
+	Pending.push_back(make_pair(A, B));
+	drain();
+}
+
+void SteensgaardPTA::assignLoc(uint32_t C, Loc L) {
+
+	C = findCell(C);
+	if (CellLocs[C].Obj == NoObj) {
+		CellLocs[C] = canonical(L);
+		return;
+	}
+	unifyLocs(CellLocs[C], L);
+	drain();
+}
+
+// Constant offset of the GEP. Variable indices are taken as 0, so
+// the elements of an array share a slot.
+int64_t SteensgaardPTA::getGEPOffset(GEPOperator *GEP) {
+
+	int64_t Off = 0;
+	for (auto GTI = gep_type_begin(GEP), GTE = gep_type_end(GEP);
+			GTI != GTE; ++GTI) {
+		ConstantInt *Idx = dyn_cast<ConstantInt>(GTI.getOperand());
+		if (!Idx || Idx->isZero())
+			continue;
+		if (StructType *STy = GTI.getStructTypeOrNull())
+			Off += CurDL->getStructLayout(STy)->getElementOffset(
+					Idx->getZExtValue());
+		else
+			Off += Idx->getSExtValue() *
+				(int64_t)CurDL->getTypeAllocSize(GTI.getIndexedType());
+	}
+	return Off;
+}
+
+Function *SteensgaardPTA::getParentFunction(Value *V) {
+
+	if (Instruction *I = dyn_cast<Instruction>(V))
+		return I->getFunction();
+	if (Argument *A = dyn_cast<Argument>(V))
+		return A->getParent();
+	return NULL;
+}
+
+uint32_t SteensgaardPTA::getCell(Value *V) {
+
+	auto it = ValueCells.find(V);
+	if (it != ValueCells.end())
+		return it->second;
+
+	// Declarations of a global in different modules are the same
+	GlobalValue *GV = dyn_cast<GlobalValue>(V);
+	if (GV && !GV->hasLocalLinkage()) {
+		auto git = GlobalCells.find(GV->getName());
+		if (git != GlobalCells.end()) {
+			ValueCells[V] = git->second;
+			CellValues.push_back(V);
+			return git->second;
+		}
+	}
+
+	uint32_t C = newCell();
+	ValueCells[V] = C;
+	CellValues.push_back(V);
+
+	// Globals and functions point to their own objects
+	if (GV) {
+		if (!GV->hasLocalLinkage())
+			GlobalCells[GV->getName()] = C;
+		CellLocs[C] = {newObj(), 0};
+	}
+	else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+		switch (CE->getOpcode()) {
+			case Instruction::BitCast:
+			case Instruction::AddrSpaceCast:
+			case Instruction::PtrToInt:
+			case Instruction::IntToPtr:
+				unifyCells(C, getCell(CE->getOperand(0)));
+				break;
+			case Instruction::GetElementPtr: {
+				Loc B = getPointee(getCell(CE->getOperand(0)));
+				B.Off += getGEPOffset(cast<GEPOperator>(CE));
+				assignLoc(C, B);
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	return C;
+}
+
+uint32_t SteensgaardPTA::getRetCell(Function *F) {
+
+	auto it = RetCells.find(F);
+	if (it != RetCells.end())
+		return it->second;
+	uint32_t C = newCell();
+	RetCells[F] = C;
+	return C;
+}
+
+// Store the pointers of a global initializer into the slots of the
+// global object
+void SteensgaardPTA::addGlobalInit(Constant *Init, Loc L) {
+
+	if (isa<ConstantData>(Init))
+		return;
+
+	if (ConstantStruct *CS = dyn_cast<ConstantStruct>(Init)) {
+		const StructLayout *SL = CurDL->getStructLayout(CS->getType());
+		for (unsigned i = 0; i < CS->getNumOperands(); ++i)
+			addGlobalInit(CS->getOperand(i),
+					{L.Obj, L.Off + (int64_t)SL->getElementOffset(i)});
+	}
+	else if (ConstantArray *CA = dyn_cast<ConstantArray>(Init)) {
+		int64_t Size = CurDL->getTypeAllocSize(
+				CA->getType()->getElementType());
+		for (unsigned i = 0; i < CA->getNumOperands(); ++i)
+			addGlobalInit(CA->getOperand(i), {L.Obj, L.Off + i * Size});
+	}
+	else if (Init->getType()->isPointerTy() || isa<ConstantExpr>(Init)) {
+		unifyCells(getSlot(L), getCell(Init));
+	}
+}
+
+// Memory copies make the contents of the objects the same; the
+// objects themselves are unified
+void SteensgaardPTA::addCopyConstraints(Value *Dst, Value *Src) {
+
+	unifyLocs(getPointee(getCell(Dst)), getPointee(getCell(Src)));
+	drain();
+}
+
+void SteensgaardPTA::addCallConstraints(CallInst *CI) {
+
+	if (MemTransferInst *MTI = dyn_cast<MemTransferInst>(CI)) {
+		addCopyConstraints(MTI->getRawDest(), MTI->getRawSource());
+		return;
+	}
+
+	FuncRoles *FR = Ctx->getCalleeRoles(CI);
+	if (FR && (FR->Mask & FR_Copy) && FR->CopyDst >= 0 && FR->CopySrc >= 0
+			&& FR->CopyDst < (int)CI->getNumArgOperands()
+			&& FR->CopySrc < (int)CI->getNumArgOperands()) {
+		addCopyConstraints(CI->getArgOperand(FR->CopyDst),
+				CI->getArgOperand(FR->CopySrc));
+	}
+
+	// Arguments are assigned to parameters, and return values to
+	// the call
+	for (Function *Callee : Ctx->CallGraph.getCallees(CI)) {
+		if (Callee->empty())
+			continue;
+		unsigned NumArgs = min((unsigned)CI->getNumArgOperands(),
+				(unsigned)Callee->arg_size());
+		for (unsigned i = 0; i < NumArgs; ++i) {
+			Value *Arg = CI->getArgOperand(i);
+			if (!Arg->getType()->isPointerTy())
+				continue;
+			unifyCells(getCell(Arg), getCell(Callee->arg_begin() + i));
+		}
+		if (CI->getType()->isPointerTy())
+			unifyCells(getCell(CI), getRetCell(Callee));
+	}
+}
+
+void SteensgaardPTA::addConstraints(Instruction *I) {
+
+	if (isa<AllocaInst>(I)) {
+		assignLoc(getCell(I), {newObj(), 0});
+	}
+	else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(I)) {
+		Loc B = getPointee(getCell(GEP->getPointerOperand()));
+		B.Off += getGEPOffset(cast<GEPOperator>(GEP));
+		assignLoc(getCell(I), B);
+	}
+	else if (isa<BitCastInst>(I) || isa<AddrSpaceCastInst>(I)
+			|| isa<PtrToIntInst>(I) || isa<IntToPtrInst>(I)) {
+		unifyCells(getCell(I), getCell(I->getOperand(0)));
+	}
+	else if (!I->getType()->isPointerTy() && !isa<StoreInst>(I)
+			&& !isa<ReturnInst>(I) && !isa<CallInst>(I)) {
+		return;
+	}
+	else if (PHINode *PN = dyn_cast<PHINode>(I)) {
+		for (Value *In : PN->incoming_values())
+			unifyCells(getCell(I), getCell(In));
+	}
+	else if (SelectInst *SI = dyn_cast<SelectInst>(I)) {
+		unifyCells(getCell(I), getCell(SI->getTrueValue()));
+		unifyCells(getCell(I), getCell(SI->getFalseValue()));
+	}
+	else if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+		uint32_t Slot = getSlot(getPointee(getCell(LI->getPointerOperand())));
+		unifyCells(getCell(I), Slot);
+	}
+	else if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+		if (!SI->getValueOperand()->getType()->isPointerTy())
+			return;
+		uint32_t Slot = getSlot(getPointee(getCell(SI->getPointerOperand())));
+		unifyCells(getCell(SI->getValueOperand()), Slot);
+	}
+	else if (ReturnInst *RI = dyn_cast<ReturnInst>(I)) {
+		Value *RV = RI->getReturnValue();
+		if (RV && RV->getType()->isPointerTy())
+			unifyCells(getRetCell(I->getFunction()), getCell(RV));
+	}
+	else if (CallInst *CI = dyn_cast<CallInst>(I)) {
+		addCallConstraints(CI);
+	}
+}
+
+void SteensgaardPTA::solve() {
+
+	OP << "[PointsTo] Solving points-to constraints of "
+		<< Ctx->Modules.size() << " modules\n";
+
+	for (auto &MP : Ctx->Modules) {
+		Module *M = MP.first;
+		CurDL = &M->getDataLayout();
+
+		for (GlobalVariable &GV : M->globals()) {
+			if (GV.hasInitializer())
+				addGlobalInit(GV.getInitializer(), getPointee(getCell(&GV)));
+		}
+
+		for (Function &F : *M) {
+			for (inst_iterator i = inst_begin(F), e = inst_end(F);
+					i != e; ++i)
+				addConstraints(&*i);
+		}
+	}
+
+	// Number the locations of the pointers in the order they were
+	// met, and drop the solver state. Pointers in the same cell class
+	// without a location are the same unknown pointer.
+	DenseMap<pair<uint32_t, int64_t>, uint32_t> LocIDs;
+	vector<uint32_t> PtrLocs;
+	vector<Value *> Ptrs;
+	for (Value *V : CellValues) {
+		if (!V->getType()->isPointerTy())
+			continue;
+		uint32_t C = findCell(ValueCells[V]);
+		Loc L = canonical(CellLocs[C]);
+		if (L.Obj == NoObj)
+			L.Off = C;
+		auto ins = LocIDs.insert(make_pair(make_pair(L.Obj, L.Off),
+					(uint32_t)LocIDs.size()));
+		ValueLocs[V] = ins.first->second;
+		Ptrs.push_back(V);
+		PtrLocs.push_back(ins.first->second);
+	}
+	NumLocs = LocIDs.size();
+
+	// Store the pointers of each location contiguously, and count the
+	// locations with pointers of more than one function
+	LocOffsets.assign(NumLocs + 1, 0);
+	for (uint32_t L : PtrLocs)
+		++LocOffsets[L + 1];
+	for (size_t L = 0; L < NumLocs; ++L)
+		LocOffsets[L + 1] += LocOffsets[L];
+	LocPointers.resize(Ptrs.size());
+	vector<uint32_t> Next(LocOffsets.begin(), LocOffsets.end() - 1);
+	vector<Function *> LocFuncs(NumLocs, NULL);
+	vector<char> LocShared(NumLocs, 0);
+	size_t NumShared = 0;
+	for (size_t i = 0; i < Ptrs.size(); ++i) {
+		uint32_t L = PtrLocs[i];
+		LocPointers[Next[L]++] = Ptrs[i];
+		Function *F = getParentFunction(Ptrs[i]);
+		if (!F || LocShared[L])
+			continue;
+		if (!LocFuncs[L])
+			LocFuncs[L] = F;
+		else if (LocFuncs[L] != F) {
+			LocShared[L] = 1;
+			++NumShared;
+		}
+	}
+
+	OP << "[PointsTo] " << CellParents.size() << " cells, "
+		<< ObjParents.size() << " objects, " << NumLocs
+		<< " locations of " << ValueLocs.size() << " pointers, "
+		<< NumShared << " of them in more than one function\n";
+
+	CellParents = vector<uint32_t>();
+	CellLocs = vector<Loc>();
+	ObjParents = vector<uint32_t>();
+	ObjFields = vector<DenseMap<int64_t, uint32_t>>();
+	ObjCollapsed = vector<char>();
+	ValueCells.clear();
+	CellValues = vector<Value *>();
+	GlobalCells.clear();
+	RetCells.clear();
+}
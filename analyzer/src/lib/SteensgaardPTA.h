@@ -0,0 +1,128 @@
+#ifndef STEENSGAARD_PTA_H
+#define STEENSGAARD_PTA_H
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Operator.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+struct GlobalContext;
+
+//
+// Unification-based (Steensgaard) points-to analysis over all
+// modules. Pointer values and the slots of memory objects are cells;
+// each class of cells points to at most one location, i.e., an
+// object class and a byte offset in it, so fields of objects are
+// kept apart. Assignments, loads, stores and calls unify the
+// locations of cells, and the unifications they imply are solved
+// with a worklist, so the analysis is near linear in the size of
+// the code. An object accessed at conflicting offsets is collapsed
+// into a single field.
+//
+// After solve(), the location of each pointer value is fixed, and
+// two pointers may alias if they have the same location. The
+// pointers of a location may belong to different functions.
+//
+class SteensgaardPTA {
+
+	public:
+		SteensgaardPTA(GlobalContext *Ctx_) : Ctx(Ctx_) { }
+
+		// Collect and solve the constraints of all modules
+		void solve();
+
+		// The location of the pointer V; ~0U if V does not point to
+		// any known location
+		uint32_t getLocationID(Value *V) const {
+			auto it = ValueLocs.find(V);
+			return it == ValueLocs.end() ? ~0U : it->second;
+		}
+
+		// The pointers of all modules with the location Loc
+		ArrayRef<Value *> getPointers(uint32_t Loc) const {
+			return makeArrayRef(LocPointers.data() + LocOffsets[Loc],
+					LocOffsets[Loc + 1] - LocOffsets[Loc]);
+		}
+
+		size_t getNumLocations() const { return NumLocs; }
+
+		// The function of a local pointer; NULL for globals and
+		// constants
+		static Function *getParentFunction(Value *V);
+
+	private:
+		GlobalContext *Ctx;
+
+		// A location: an object and a byte offset in it
+		struct Loc {
+			uint32_t Obj;
+			int64_t Off;
+		};
+		static const uint32_t NoObj = ~0U;
+
+		// Union-find of cells, with the location of each class at
+		// its root
+		vector<uint32_t> CellParents;
+		vector<Loc> CellLocs;
+
+		// Union-find of objects; the slots of each class by offset
+		// at its root
+		vector<uint32_t> ObjParents;
+		vector<DenseMap<int64_t, uint32_t>> ObjFields;
+		vector<char> ObjCollapsed;
+
+		DenseMap<Value *, uint32_t> ValueCells;
+		// Values with cells, in the order they were met
+		vector<Value *> CellValues;
+		StringMap<uint32_t> GlobalCells;
+		DenseMap<Function *, uint32_t> RetCells;
+		const DataLayout *CurDL = NULL;
+
+		// Pairs of cells to unify
+		vector<pair<uint32_t, uint32_t>> Pending;
+
+		DenseMap<Value *, uint32_t> ValueLocs;
+		size_t NumLocs = 0;
+		// Pointers of location i are LocPointers[LocOffsets[i],
+		// LocOffsets[i + 1])
+		vector<uint32_t> LocOffsets;
+		vector<Value *> LocPointers;
+
+		uint32_t newCell();
+		uint32_t newObj();
+		uint32_t findCell(uint32_t C);
+		uint32_t findObj(uint32_t O);
+
+		Loc canonical(Loc L);
+		// The location the cell points to, with a new object if it
+		// has none
+		Loc getPointee(uint32_t C);
+		// The cell of the slot at L
+		uint32_t getSlot(Loc L);
+
+		void unifyCells(uint32_t A, uint32_t B);
+		void unifyLocs(Loc A, Loc B);
+		void mergeObjs(uint32_t A, uint32_t B);
+		void collapse(uint32_t O);
+		void drain();
+		// Make cell C point to L
+		void assignLoc(uint32_t C, Loc L);
+
+		uint32_t getCell(Value *V);
+		uint32_t getRetCell(Function *F);
+		int64_t getGEPOffset(GEPOperator *GEP);
+
+		void addGlobalInit(Constant *Init, Loc L);
+		void addConstraints(Instruction *I);
+		void addCallConstraints(CallInst *CI);
+		void addCopyConstraints(Value *Dst, Value *Src);
+};
+
+#endif
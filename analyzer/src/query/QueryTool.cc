@@ -0,0 +1,404 @@
+//===-- QueryTool.cc - Query a saved global call-graph----------===//
+//
+// kanalyzer-query answers questions about the call graph saved by
+// "kanalyzer -cg-file=<file>", without loading any bitcode:
+//
+//   find <name>            functions with the name
+//   at <file>:<line>       functions and call sites at the location
+//   callers <name>         call sites that may call the function
+//   callees <name>         targets of the calls in the function
+//   reach <name>           functions transitively called
+//   reached-by <name>      functions transitively calling
+//
+// Commands are given after the file name, or read from stdin, one
+// per line, when there is none. File names match by suffix.
+//
+//===-----------------------------------------------------------===//
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <iostream>
+
+#include "CallGraphFile.h"
+
+using namespace llvm;
+using namespace std;
+
+cl::opt<string> GraphFile(cl::Positional, cl::Required,
+		cl::desc("<call-graph file>"));
+
+cl::list<string> Command(cl::Positional, cl::ZeroOrMore,
+		cl::desc("<command> <argument>"));
+
+#define OP llvm::outs()
+
+struct SourceLoc {
+	uint32_t File, Line;
+};
+
+//
+// The call graph read from the file, with indexes for the queries
+//
+class CallGraphIndex {
+
+	public:
+		bool load(StringRef Path);
+		void query(StringRef Cmd, StringRef Arg);
+
+	private:
+		unique_ptr<MemoryBuffer> Buf;
+
+		vector<StringRef> Modules, Files;
+		vector<uint32_t> FuncModules;
+		vector<StringRef> FuncNames;
+		vector<SourceLoc> FuncLocs;
+		StringMap<vector<uint32_t>> NameFuncs;
+
+		// Callee sets, and the sets containing each function
+		vector<uint32_t> SetOffsets, SetCol;
+		vector<vector<uint32_t>> FuncSets;
+		// Call sites of each set, and of each caller
+		vector<vector<uint32_t>> SetCalls, FuncCalls;
+
+		vector<uint32_t> CallFuncs, CallSetIDs;
+		uint32_t NumDirect;
+		vector<SourceLoc> CallLocs;
+
+		void printLoc(const SourceLoc &Loc);
+		void printFunc(uint32_t FID);
+		void printCall(uint32_t CID);
+		bool lookupFuncs(StringRef Name, vector<uint32_t> &FIDs);
+		bool parseLoc(StringRef Arg, StringRef &File, unsigned &Line);
+		bool matchLoc(const SourceLoc &Loc, StringRef File, unsigned Line);
+		void reach(vector<uint32_t> &FIDs, bool Forward);
+};
+
+bool CallGraphIndex::load(StringRef Path) {
+
+	auto BufOrErr = MemoryBuffer::getFile(Path, -1, false);
+	if (!BufOrErr) {
+		errs() << "Cannot open " << Path << "\n";
+		return false;
+	}
+	Buf = std::move(*BufOrErr);
+	CGFileReader R(Buf->getBuffer());
+	auto invalid = [&]() {
+		errs() << Path << " is invalid\n";
+		return false;
+	};
+
+	if (R.u32() != CG_FILE_MAGIC || R.u32() != CG_FILE_VERSION) {
+		errs() << Path << " is not a call-graph file of this version\n";
+		return false;
+	}
+	R.u64();
+
+	// Modules and the hashes of their inputs
+	uint32_t NumModules = R.count(12);
+	for (uint32_t i = 0; i < NumModules; ++i) {
+		Modules.push_back(R.str());
+		R.u64();
+	}
+
+	uint32_t NumFuncs = R.count(8);
+	for (uint32_t i = 0; i < NumFuncs; ++i) {
+		FuncModules.push_back(R.u32());
+		FuncNames.push_back(R.str());
+		NameFuncs[FuncNames.back()].push_back(i);
+	}
+
+	uint32_t NumSets = R.count(4);
+	SetOffsets.push_back(0);
+	FuncSets.resize(NumFuncs);
+	for (uint32_t s = 0; s < NumSets; ++s) {
+		uint32_t N = R.count(4);
+		for (uint32_t j = 0; j < N; ++j) {
+			uint32_t FID = R.u32();
+			if (FID >= NumFuncs)
+				return invalid();
+			SetCol.push_back(FID);
+			FuncSets[FID].push_back(s);
+		}
+		SetOffsets.push_back(SetCol.size());
+	}
+
+	uint32_t NumCalls = R.count(16);
+	NumDirect = R.u32();
+	SetCalls.resize(NumSets);
+	FuncCalls.resize(NumFuncs);
+	for (uint32_t i = 0; i < NumCalls; ++i) {
+		uint32_t FID = R.u32();
+		R.u32();
+		uint32_t SID = R.u32();
+		R.u32();
+		if (FID >= NumFuncs || SID >= NumSets)
+			return invalid();
+		CallFuncs.push_back(FID);
+		CallSetIDs.push_back(SID);
+		SetCalls[SID].push_back(i);
+		FuncCalls[FID].push_back(i);
+	}
+
+	// Module facts: address-taken, global and unified functions,
+	// typeFuncsMap, typeConfineMap, typeTransitMap, typeEscapeSet
+	// and typeFieldsMap
+	for (uint32_t m = 0; m < NumModules && !R.failed(); ++m) {
+		R.skip((size_t)R.count(12) * 12);
+		uint32_t NumGlobals = R.count(8);
+		for (uint32_t i = 0; i < NumGlobals; ++i) {
+			R.str();
+			R.u32();
+		}
+		R.skip((size_t)R.count(12) * 12);
+		R.skipMap(4);
+		R.skipMap(8);
+		R.skipMap(8);
+		R.skip((size_t)R.count(8) * 8);
+		R.skipMap(4);
+	}
+
+	uint32_t NumFiles = R.count(4);
+	for (uint32_t i = 0; i < NumFiles; ++i)
+		Files.push_back(R.str());
+	for (uint32_t i = 0; i < NumFuncs; ++i) {
+		SourceLoc Loc;
+		Loc.File = R.u32();
+		Loc.Line = R.u32();
+		FuncLocs.push_back(Loc);
+	}
+	for (uint32_t i = 0; i < NumCalls; ++i) {
+		SourceLoc Loc;
+		Loc.File = R.u32();
+		Loc.Line = R.u32();
+		CallLocs.push_back(Loc);
+	}
+
+	if (R.failed() || !R.atEnd())
+		return invalid();
+	for (auto &Loc : FuncLocs)
+		if (Loc.File >= Files.size())
+			return invalid();
+	for (auto &Loc : CallLocs)
+		if (Loc.File >= Files.size())
+			return invalid();
+	return true;
+}
+
+void CallGraphIndex::printLoc(const SourceLoc &Loc) {
+
+	if (Loc.File == 0)
+		OP << "<unknown>";
+	else
+		OP << Files[Loc.File] << ":" << Loc.Line;
+}
+
+void CallGraphIndex::printFunc(uint32_t FID) {
+
+	OP << FuncNames[FID] << " (";
+	printLoc(FuncLocs[FID]);
+	if (FuncModules[FID] < Modules.size())
+		OP << ", " << Modules[FuncModules[FID]];
+	OP << ")";
+}
+
+void CallGraphIndex::printCall(uint32_t CID) {
+
+	OP << FuncNames[CallFuncs[CID]] << " @ ";
+	printLoc(CallLocs[CID]);
+	OP << (CID >= NumDirect ? " [indirect]" : "");
+}
+
+bool CallGraphIndex::lookupFuncs(StringRef Name, vector<uint32_t> &FIDs) {
+
+	auto it = NameFuncs.find(Name);
+	if (it == NameFuncs.end()) {
+		OP << "No function named " << Name << "\n";
+		return false;
+	}
+	FIDs = it->second;
+	return true;
+}
+
+bool CallGraphIndex::parseLoc(StringRef Arg, StringRef &File,
+		unsigned &Line) {
+
+	auto Split = Arg.rsplit(':');
+	if (Split.second.getAsInteger(10, Line)) {
+		OP << "Expected <file>:<line>\n";
+		return false;
+	}
+	File = Split.first;
+	return true;
+}
+
+bool CallGraphIndex::matchLoc(const SourceLoc &Loc, StringRef File,
+		unsigned Line) {
+
+	return Loc.File != 0 && Loc.Line == Line
+		&& Files[Loc.File].endswith(File);
+}
+
+// Print the functions transitively called by (Forward) or calling
+// the given functions
+void CallGraphIndex::reach(vector<uint32_t> &FIDs, bool Forward) {
+
+	DenseSet<uint32_t> Visited(FIDs.begin(), FIDs.end());
+	deque<uint32_t> WorkList(FIDs.begin(), FIDs.end());
+	vector<uint32_t> Reached;
+	DenseSet<uint32_t> VisitedSets;
+
+	while (!WorkList.empty()) {
+		uint32_t FID = WorkList.front();
+		WorkList.pop_front();
+
+		auto visit = [&](uint32_t Next) {
+			if (Visited.insert(Next).second) {
+				Reached.push_back(Next);
+				WorkList.push_back(Next);
+			}
+		};
+		if (Forward) {
+			for (uint32_t CID : FuncCalls[FID]) {
+				uint32_t S = CallSetIDs[CID];
+				if (!VisitedSets.insert(S).second)
+					continue;
+				for (uint32_t j = SetOffsets[S]; j < SetOffsets[S + 1]; ++j)
+					visit(SetCol[j]);
+			}
+		}
+		else {
+			for (uint32_t S : FuncSets[FID])
+				for (uint32_t CID : SetCalls[S])
+					visit(CallFuncs[CID]);
+		}
+	}
+
+	OP << Reached.size() << " functions\n";
+	for (uint32_t FID : Reached) {
+		OP << "  ";
+		printFunc(FID);
+		OP << "\n";
+	}
+}
+
+void CallGraphIndex::query(StringRef Cmd, StringRef Arg) {
+
+	vector<uint32_t> FIDs;
+
+	if (Cmd == "find") {
+		if (!lookupFuncs(Arg, FIDs))
+			return;
+		for (uint32_t FID : FIDs) {
+			printFunc(FID);
+			OP << "\n";
+		}
+	}
+	else if (Cmd == "at") {
+		StringRef File;
+		unsigned Line;
+		if (!parseLoc(Arg, File, Line))
+			return;
+		for (uint32_t FID = 0; FID < FuncLocs.size(); ++FID) {
+			if (matchLoc(FuncLocs[FID], File, Line)) {
+				OP << "function ";
+				printFunc(FID);
+				OP << "\n";
+			}
+		}
+		for (uint32_t CID = 0; CID < CallLocs.size(); ++CID) {
+			if (!matchLoc(CallLocs[CID], File, Line))
+				continue;
+			OP << "call ";
+			printCall(CID);
+			OP << "\n";
+			uint32_t S = CallSetIDs[CID];
+			for (uint32_t j = SetOffsets[S]; j < SetOffsets[S + 1]; ++j) {
+				OP << "  -> ";
+				printFunc(SetCol[j]);
+				OP << "\n";
+			}
+		}
+	}
+	else if (Cmd == "callers") {
+		if (!lookupFuncs(Arg, FIDs))
+			return;
+		for (uint32_t FID : FIDs) {
+			printFunc(FID);
+			OP << "\n";
+			for (uint32_t S : FuncSets[FID]) {
+				for (uint32_t CID : SetCalls[S]) {
+					OP << "  <- ";
+					printCall(CID);
+					OP << "\n";
+				}
+			}
+		}
+	}
+	else if (Cmd == "callees") {
+		if (!lookupFuncs(Arg, FIDs))
+			return;
+		for (uint32_t FID : FIDs) {
+			printFunc(FID);
+			OP << "\n";
+			for (uint32_t CID : FuncCalls[FID]) {
+				uint32_t S = CallSetIDs[CID];
+				OP << "  ";
+				printLoc(CallLocs[CID]);
+				OP << (CID >= NumDirect ? " [indirect]" : "") << "\n";
+				for (uint32_t j = SetOffsets[S]; j < SetOffsets[S + 1]; ++j) {
+					OP << "    -> ";
+					printFunc(SetCol[j]);
+					OP << "\n";
+				}
+			}
+		}
+	}
+	else if (Cmd == "reach" || Cmd == "reached-by") {
+		if (!lookupFuncs(Arg, FIDs))
+			return;
+		reach(FIDs, Cmd == "reach");
+	}
+	else
+		OP << "Unknown command: " << Cmd << "\n";
+}
+
+int main(int argc, char **argv) {
+
+	cl::ParseCommandLineOptions(argc, argv, "Query a saved call graph\n");
+
+	auto LoadStart = chrono::steady_clock::now();
+	CallGraphIndex Index;
+	if (!Index.load(GraphFile))
+		return 1;
+	auto LoadEnd = chrono::steady_clock::now();
+	errs() << "Loaded " << GraphFile << " in "
+		<< chrono::duration_cast<chrono::milliseconds>(
+				LoadEnd - LoadStart).count() << " ms\n";
+
+	if (!Command.empty()) {
+		if (Command.size() != 2) {
+			errs() << "Expected <command> <argument>\n";
+			return 1;
+		}
+		Index.query(Command[0], Command[1]);
+		return 0;
+	}
+
+	string Line;
+	while (getline(cin, Line)) {
+		auto Split = StringRef(Line).trim().split(' ');
+		if (Split.first.empty())
+			continue;
+		Index.query(Split.first, Split.second.trim());
+		OP.flush();
+	}
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+; A saved call graph is updated when one of its modules changes. The
+; test holds three modules, a.ll and two versions of b.ll, split out
+; by sed. In the second version, @b_fn is gone and @b_helper takes its
+; place in @b_ops. Only the indirect call through %struct.ops is
+; resolved again; the call through %struct.hooks and the direct call
+; to @b_helper keep their callees. The result must be the same as the
+; one of a full rebuild.
+;
+; RUN: sed -n '/^; a.ll$/,/^; end$/p' %s > %t.a.ll
+; RUN: sed -n '/^; b.ll$/,/^; end$/p' %s > %t.b.ll
+; RUN: %kanalyzer -cg-file %t.cg %t.a.ll %t.b.ll
+; RUN: sed -n '/^; b2.ll$/,/^; end$/p' %s > %t.b.ll
+; RUN: %kanalyzer -cg-file %t.cg -cg-verify %t.a.ll %t.b.ll
+; CHECK: 1 of 2 modules changed
+; CHECK: [CallGraph] Updating the call graph: 1 modules removed, 1 added
+; CHECK: [CallGraph] 1 call sites resolved, 2 kept
+; CHECK: [CallGraph] Verified the call graph: 3 call sites, 0 mismatches
+
+; a.ll
+%struct.ops = type { i32 (i32)* }
+%struct.hooks = type { void (i8*)* }
+
+@a_ops = global %struct.ops { i32 (i32)* @a_fn }
+
+declare i32 @b_helper(i32)
+
+define i32 @a_fn(i32 %x) {
+entry:
+  ret i32 %x
+}
+
+define i32 @call_ops(%struct.ops* %o, i32 %x) {
+entry:
+  %fp = getelementptr %struct.ops, %struct.ops* %o, i32 0, i32 0
+  %f = load i32 (i32)*, i32 (i32)** %fp
+  %r = call i32 %f(i32 %x)
+  ret i32 %r
+}
+
+define void @call_hooks(%struct.hooks* %h, i8* %p) {
+entry:
+  %fp = getelementptr %struct.hooks, %struct.hooks* %h, i32 0, i32 0
+  %f = load void (i8*)*, void (i8*)** %fp
+  call void %f(i8* %p)
+  ret void
+}
+
+define i32 @call_helper(i32 %x) {
+entry:
+  %r = call i32 @b_helper(i32 %x)
+  ret i32 %r
+}
+; end
+
+; b.ll
+%struct.ops = type { i32 (i32)* }
+%struct.hooks = type { void (i8*)* }
+
+@b_ops = global %struct.ops { i32 (i32)* @b_fn }
+@b_hooks = global %struct.hooks { void (i8*)* @b_hook }
+
+define i32 @b_helper(i32 %x) {
+entry:
+  ret i32 0
+}
+
+define i32 @b_fn(i32 %x) {
+entry:
+  ret i32 1
+}
+
+define void @b_hook(i8* %p) {
+entry:
+  ret void
+}
+; end
+
+; b2.ll
+%struct.ops = type { i32 (i32)* }
+%struct.hooks = type { void (i8*)* }
+
+@b_ops = global %struct.ops { i32 (i32)* @b_helper }
+@b_hooks = global %struct.hooks { void (i8*)* @b_hook }
+
+define i32 @b_helper(i32 %x) {
+entry:
+  ret i32 0
+}
+
+define void @b_hook(i8* %p) {
+entry:
+  ret void
+}
+; end
@@ -0,0 +1,25 @@
+; A block that may return an error (the result of @get) branches to a
+; block that must return one. The edge between them takes the flag of
+; the latter, so the branch in %entry is a sanity check.
+;
+; RUN: %kanalyzer -sc %s
+; CHECK: # Number of sanity checks: 1
+
+define i32 @get(i32 %x) {
+entry:
+  ret i32 0
+}
+
+define i32 @check(i32 %x) {
+entry:
+  %r = call i32 @get(i32 %x)
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
@@ -0,0 +1,99 @@
+; The result of @get is checked in @check0-@check2 and left unchecked
+; in @skip. @put stores it through %p, and @take checks it after
+; loading it through %q. With the global points-to analysis, %p and
+; %q share a location (both point to %b of @drive), so the value is
+; followed into @take and found checked there: one uncheck in five
+; calls reports @get. Without it, @put also counts as an uncheck, and
+; the rating of 2/5 is above the reporting threshold.
+;
+; RUN: %kanalyzer -mc -global-pta %s
+; CHECK: == [Src-retval]: Rating: 0.250, Checks: 3, Unchecks: 1, Total: 4 | Arg: -1
+
+define i32 @get() {
+entry:
+  ret i32 0
+}
+
+define void @use(i32 %x) {
+entry:
+  ret void
+}
+
+define i32 @check0() {
+entry:
+  %r = call i32 @get()
+  %c = icmp slt i32 %r, 0
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ 0, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check1() {
+entry:
+  %r = call i32 @get()
+  %c = icmp slt i32 %r, 0
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ 0, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check2() {
+entry:
+  %r = call i32 @get()
+  %c = icmp slt i32 %r, 0
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ 0, %entry ]
+  ret i32 %ret
+}
+
+define void @skip() {
+entry:
+  %r = call i32 @get()
+  call void @use(i32 %r)
+  ret void
+}
+
+define void @put(i32* %p) {
+entry:
+  %r = call i32 @get()
+  store i32 %r, i32* %p
+  ret void
+}
+
+define i32 @take(i32* %q) {
+entry:
+  %v = load i32, i32* %q
+  %c = icmp slt i32 %v, 0
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ 0, %entry ]
+  ret i32 %ret
+}
+
+define void @drive() {
+entry:
+  %b = alloca i32
+  call void @put(i32* %b)
+  %t = call i32 @take(i32* %b)
+  call void @use(i32 %t)
+  ret void
+}
@@ -0,0 +1,152 @@
+; The functions with sanity checks are analyzed by parallel workers,
+; which share the LLVMContext of the module. Each function has an
+; assumption, so that the assumption caches of the workers register
+; value handles in the context. The results must be the same as those
+; of a serial run; the thread counts in the log are left out.
+;
+; RUN: %kanalyzer -mc -j 1 %s 2>&1 | grep -v threads > %t.1
+; RUN: %kanalyzer -mc -j 8 %s 2>&1 | grep -v threads > %t.8
+; RUN: diff %t.1 %t.8
+
+declare void @llvm.assume(i1)
+
+define i32 @get(i32 %x) {
+entry:
+  ret i32 0
+}
+
+define i32 @check0(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check1(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 1
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check2(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 2
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check3(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 3
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check4(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 4
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check5(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 5
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check6(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 6
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
+
+define i32 @check7(i32* %p, i32 %x) {
+entry:
+  %nn = icmp ne i32* %p, null
+  call void @llvm.assume(i1 %nn)
+  %v = load i32, i32* %p
+  %r = call i32 @get(i32 %v)
+  %c = icmp eq i32 %x, 7
+  br i1 %c, label %err, label %out
+
+err:
+  br label %out
+
+out:
+  %ret = phi i32 [ -22, %err ], [ %r, %entry ]
+  ret i32 %ret
+}
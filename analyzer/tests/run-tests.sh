@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Run the analyzer tests: run-tests.sh <kanalyzer> [test.ll ...]
+#
+# Each test is an LLVM IR file with directives in comments:
+#   ; RUN: <command>    run with sh; %kanalyzer is the analyzer, %s the
+#                       test file and %t a scratch path for the test
+#   ; CHECK: <text>     the output of the RUN lines must contain the
+#                       text; runs of blanks and tabs match one space
+# A test fails if a RUN line exits with an error or a CHECK is missing.
+#
+
+KANALYZER=$1
+shift
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+if [ $# -eq 0 ]; then
+	set -- "$TESTDIR"/*.ll
+fi
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+
+Failed=0
+for Test in "$@"; do
+	Name=$(basename "$Test" .ll)
+	Out="$TMPDIR/$Name.out"
+	: > "$Out"
+	Status=0
+
+	sed -n 's/^; RUN: //p' "$Test" > "$TMPDIR/$Name.run"
+	while read -r Cmd; do
+		Cmd=$(printf '%s' "$Cmd" | sed -e "s|%kanalyzer|$KANALYZER|g" \
+			-e "s|%s|$Test|g" -e "s|%t|$TMPDIR/$Name.tmp|g")
+		if ! sh -c "$Cmd" >> "$Out" 2>&1; then
+			echo "$Name: failed: $Cmd"
+			Status=1
+		fi
+	done < "$TMPDIR/$Name.run"
+
+	tr -s ' \t' '  ' < "$Out" > "$Out.norm"
+	sed -n 's/^; CHECK: //p' "$Test" > "$TMPDIR/$Name.check"
+	while read -r Check; do
+		Check=$(printf '%s' "$Check" | tr -s ' \t' '  ')
+		if ! grep -qF -- "$Check" "$Out.norm"; then
+			echo "$Name: missing: $Check"
+			Status=1
+		fi
+	done < "$TMPDIR/$Name.check"
+
+	if [ $Status -ne 0 ]; then
+		sed 's/^/  | /' "$Out"
+		Failed=$((Failed + 1))
+	else
+		echo "$Name: passed"
+	fi
+done
+
+[ $Failed -eq 0 ]